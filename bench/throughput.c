@@ -0,0 +1,419 @@
+// parse throughput, lookup latency and peak memory of ini.h on generated
+// configs of a few sizes, side by side with other parsers on the same corpus.
+// inih is added when its ini.c is in bench/vendor/inih, see BENCH_INIH
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static size_t live_bytes, peak_bytes;
+
+static void count_alloc(size_t size) {
+    live_bytes += size;
+    if (live_bytes > peak_bytes) peak_bytes = live_bytes;
+}
+
+#ifdef __GLIBC__
+// every parser ends up calling malloc (operator new included), so replacing it
+// counts the memory of any of them without patching them
+#include <malloc.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    if (ptr) count_alloc(malloc_usable_size(ptr));
+    return ptr;
+}
+
+void *calloc(size_t count, size_t size) {
+    void *ptr = __libc_calloc(count, size);
+    if (ptr) count_alloc(malloc_usable_size(ptr));
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+    size_t old = ptr ? malloc_usable_size(ptr) : 0;
+    void *new_ptr = __libc_realloc(ptr, size);
+    if (new_ptr) {
+        live_bytes -= old;
+        count_alloc(malloc_usable_size(new_ptr));
+    }
+    else if (ptr && size == 0) {
+        live_bytes -= old;
+    }
+    return new_ptr;
+}
+
+void *aligned_alloc(size_t align, size_t size) {
+    void *ptr = __libc_memalign(align, size);
+    if (ptr) count_alloc(malloc_usable_size(ptr));
+    return ptr;
+}
+
+int posix_memalign(void **out, size_t align, size_t size) {
+    void *ptr = __libc_memalign(align, size);
+    if (!ptr) return 12; // ENOMEM
+    count_alloc(malloc_usable_size(ptr));
+    *out = ptr;
+    return 0;
+}
+
+void free(void *ptr) {
+    if (ptr) live_bytes -= malloc_usable_size(ptr);
+    __libc_free(ptr);
+}
+
+#define BENCH_PEAK_NOTE "peak memory counts every malloc"
+#else
+// without glibc only what goes through the ini.h hooks is counted, every
+// allocation keeps its size in front of it so that frees can be counted
+#define BENCH_HEADER 16
+
+static void *bench_malloc(size_t size) {
+    unsigned char *p = malloc(size + BENCH_HEADER);
+    if (!p) return NULL;
+    memcpy(p, &size, sizeof(size));
+    count_alloc(size);
+    return p + BENCH_HEADER;
+}
+
+static void bench_free(void *ptr) {
+    if (!ptr) return;
+    unsigned char *p = (unsigned char *)ptr - BENCH_HEADER;
+    size_t size;
+    memcpy(&size, p, sizeof(size));
+    live_bytes -= size;
+    free(p);
+}
+
+static void *bench_realloc(void *ptr, size_t size) {
+    if (!ptr) return bench_malloc(size);
+    unsigned char *p = (unsigned char *)ptr - BENCH_HEADER;
+    size_t old;
+    memcpy(&old, p, sizeof(old));
+    p = realloc(p, size + BENCH_HEADER);
+    if (!p) return NULL;
+    memcpy(p, &size, sizeof(size));
+    live_bytes -= old;
+    count_alloc(size);
+    return p + BENCH_HEADER;
+}
+
+#define INI_MALLOC(size)       bench_malloc(size)
+#define INI_REALLOC(ptr, size) bench_realloc(ptr, size)
+#define INI_FREE(ptr)          bench_free(ptr)
+#define BENCH_PEAK_NOTE "peak memory only counts the ini.h hooks"
+#endif
+
+#define INI_IMPLEMENTATION
+#include "../ini.h"
+
+#define RUNS           5
+#define LOOKUPS        (1 << 20)
+// linear lookups in big documents are slow, stop after this many ns
+#define LOOKUP_BUDGET  1e9
+
+typedef struct {
+    const char *name;
+    // parses <len> bytes of <text> (NUL terminated), returns NULL on failure
+    void *(*parse)(const char *text, size_t len);
+    // returns true if <key> was found in <table>
+    bool (*lookup)(void *doc, const char *table, const char *key);
+    void (*free)(void *doc);
+} bench_parser_t;
+
+static void *ini_parse_with(const char *text, size_t len, const iniopts_t *opts) {
+    ini_t *ini = malloc(sizeof(ini_t));
+    if (!ini) return NULL;
+    *ini = ini_parse_buf(text, len, opts);
+    if (!ini_is_valid(ini)) {
+        free(ini);
+        return NULL;
+    }
+    return ini;
+}
+
+static void *ini_default_parse(const char *text, size_t len) {
+    return ini_parse_with(text, len, NULL);
+}
+
+static void *ini_indexed_parse(const char *text, size_t len) {
+    return ini_parse_with(text, len, &(iniopts_t){ .lookup_index = true });
+}
+
+static void *ini_fingerprint_parse(const char *text, size_t len) {
+    return ini_parse_with(text, len, &(iniopts_t){ .fingerprint = true });
+}
+
+static bool ini_lookup(void *doc, const char *table, const char *key) {
+    return ini_get(ini_get_table(doc, table), key) != NULL;
+}
+
+static void ini_doc_free(void *doc) {
+    ini_free(doc);
+    free(doc);
+}
+
+#ifdef BENCH_INIH
+// inih is built from bench/vendor/inih/ini.c with its functions renamed to
+// inih_*, so that they don't clash with ini.h. it only calls back for every
+// key, so the adapter keeps them in a hash table like a program using it would
+typedef int (*inih_handler)(void *user, const char *section, const char *name, const char *value);
+int inih_parse_string(const char *string, inih_handler handler, void *user);
+
+typedef struct {
+    char *section, *name, *value;
+} inih_entry_t;
+
+typedef struct {
+    inih_entry_t *entries;
+    size_t len, cap;
+} inih_doc_t;
+
+static size_t inih_hash(const char *section, const char *name) {
+    // fnv-1a over both names
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *section; ++section) hash = (hash ^ (unsigned char)*section) * 0x100000001b3ULL;
+    hash = (hash ^ 0xff) * 0x100000001b3ULL;
+    for (; *name; ++name) hash = (hash ^ (unsigned char)*name) * 0x100000001b3ULL;
+    return (size_t)hash;
+}
+
+static void inih_insert(inih_doc_t *doc, inih_entry_t entry) {
+    size_t mask = doc->cap - 1;
+    size_t i = inih_hash(entry.section, entry.name) & mask;
+    while (doc->entries[i].name) i = (i + 1) & mask;
+    doc->entries[i] = entry;
+    doc->len++;
+}
+
+static int inih_on_key(void *user, const char *section, const char *name, const char *value) {
+    inih_doc_t *doc = user;
+    if ((doc->len + 1) * 2 > doc->cap) {
+        inih_doc_t grown = { calloc(doc->cap ? doc->cap * 2 : 64, sizeof(inih_entry_t)), 0, doc->cap ? doc->cap * 2 : 64 };
+        if (!grown.entries) return 0;
+        for (size_t i = 0; i < doc->cap; ++i) {
+            if (doc->entries[i].name) inih_insert(&grown, doc->entries[i]);
+        }
+        free(doc->entries);
+        *doc = grown;
+    }
+    inih_entry_t entry = { strdup(section), strdup(name), strdup(value) };
+    if (!entry.section || !entry.name || !entry.value) {
+        free(entry.section);
+        free(entry.name);
+        free(entry.value);
+        return 0;
+    }
+    inih_insert(doc, entry);
+    return 1;
+}
+
+static void inih_doc_free(void *ptr) {
+    inih_doc_t *doc = ptr;
+    for (size_t i = 0; i < doc->cap; ++i) {
+        free(doc->entries[i].section);
+        free(doc->entries[i].name);
+        free(doc->entries[i].value);
+    }
+    free(doc->entries);
+    free(doc);
+}
+
+static void *inih_doc_parse(const char *text, size_t len) {
+    (void)len;
+    inih_doc_t *doc = calloc(1, sizeof(inih_doc_t));
+    if (!doc) return NULL;
+    if (inih_parse_string(text, inih_on_key, doc) != 0) {
+        inih_doc_free(doc);
+        return NULL;
+    }
+    return doc;
+}
+
+static bool inih_lookup(void *ptr, const char *table, const char *key) {
+    inih_doc_t *doc = ptr;
+    if (!doc->cap) return false;
+    size_t mask = doc->cap - 1;
+    for (size_t i = inih_hash(table, key) & mask; doc->entries[i].name; i = (i + 1) & mask) {
+        if (strcmp(doc->entries[i].name, key) == 0 && strcmp(doc->entries[i].section, table) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#define BENCH_INIH_PARSER { "inih + hash table", inih_doc_parse, inih_lookup, inih_doc_free },
+#else
+#define BENCH_INIH_PARSER
+#endif
+
+// more parsers can be added with an adapter in a header, built with
+// -DBENCH_PARSERS='"adapters.h"'. the header must define BENCH_EXTRA_PARSERS
+// as a list of bench_parser_t
+#ifdef BENCH_PARSERS
+#include BENCH_PARSERS
+#endif
+
+#ifndef BENCH_EXTRA_PARSERS
+#define BENCH_EXTRA_PARSERS
+#endif
+
+static const bench_parser_t parsers[] = {
+    { "ini.h",              ini_default_parse, ini_lookup, ini_doc_free },
+    { "ini.h lookup_index", ini_indexed_parse, ini_lookup, ini_doc_free },
+    { "ini.h fingerprint",  ini_fingerprint_parse, ini_lookup, ini_doc_free },
+    BENCH_INIH_PARSER
+    BENCH_EXTRA_PARSERS
+};
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+} text_t;
+
+static void putf(text_t *t, const char *fmt, ...) {
+    va_list args;
+    for (;;) {
+        va_start(args, fmt);
+        int n = vsnprintf(t->buf + t->len, t->cap - t->len, fmt, args);
+        va_end(args);
+        if (n >= 0 && t->len + (size_t)n < t->cap) {
+            t->len += (size_t)n;
+            return;
+        }
+        t->cap = t->cap ? t->cap * 2 : 4096;
+        t->buf = realloc(t->buf, t->cap);
+        if (!t->buf) { fprintf(stderr, "out of memory\n"); exit(1); }
+    }
+}
+
+static uint64_t rng_state = 0x853c49e6748fea9bULL;
+
+static unsigned int rng(unsigned int n) {
+    rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int)(rng_state >> 33) % n;
+}
+
+typedef struct {
+    const char *name;
+    unsigned int tables, keys;
+} corpus_t;
+
+static const char *words[] = { "server", "client", "cache", "limit", "timeout", "path", "name", "user", "mode", "level" };
+
+// a config like the ones people write: comments, empty lines and a mix of
+// numbers, booleans, strings and lists. a comment line ends a table, so they
+// only go before the table names
+static void gen_corpus(text_t *t, const corpus_t *c) {
+    putf(t, "; generated config, %u tables of %u keys\n", c->tables, c->keys);
+    putf(t, "name = bench\nversion = 3\n\n");
+    for (unsigned int i = 0; i < c->tables; ++i) {
+        putf(t, "# %s %u\n[%s_%u]\n", words[i % 10], i, words[i % 10], i);
+        for (unsigned int k = 0; k < c->keys; ++k) {
+            const char *word = words[(i + k) % 10];
+            switch (rng(6)) {
+                case 0: putf(t, "%s_%u = %u\n", word, k, rng(100000)); break;
+                case 1: putf(t, "%s_%u = %u.%03u\n", word, k, rng(1000), rng(1000)); break;
+                case 2: putf(t, "%s_%u = %s\n", word, k, rng(2) ? "true" : "false"); break;
+                case 3: putf(t, "%s_%u = \"/var/lib/%s/%u\"\n", word, k, word, rng(1000)); break;
+                case 4: putf(t, "%s_%u = %u, %u, %u ; list\n", word, k, rng(100), rng(100), rng(100)); break;
+                default: putf(t, "%s_%u = %s %s # %s\n", word, k, word, words[rng(10)], word); break;
+            }
+        }
+        putf(t, "\n");
+    }
+}
+
+typedef struct {
+    char table[64];
+    char key[64];
+} lookup_t;
+
+// existing keys picked at random, named the same way gen_corpus names them
+static lookup_t *gen_lookups(const corpus_t *c) {
+    lookup_t *lookups = malloc(sizeof(lookup_t) * LOOKUPS);
+    if (!lookups) { fprintf(stderr, "out of memory\n"); exit(1); }
+    for (unsigned int i = 0; i < LOOKUPS; ++i) {
+        unsigned int tab = rng(c->tables), k = rng(c->keys);
+        snprintf(lookups[i].table, sizeof(lookups[i].table), "%s_%u", words[tab % 10], tab);
+        snprintf(lookups[i].key, sizeof(lookups[i].key), "%s_%u", words[(tab + k) % 10], k);
+    }
+    return lookups;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void bench(const bench_parser_t *parser, const text_t *text, const lookup_t *lookups) {
+    double best = 0;
+    size_t peak = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        size_t base = live_bytes;
+        peak_bytes = live_bytes;
+        double start = now();
+        void *doc = parser->parse(text->buf, text->len);
+        double elapsed = now() - start;
+        if (!doc) {
+            fprintf(stderr, "%s: couldn't parse the corpus\n", parser->name);
+            exit(1);
+        }
+        peak = peak_bytes - base;
+        if (run == 0 || elapsed < best) best = elapsed;
+        if (run < RUNS - 1) parser->free(doc);
+        else {
+            unsigned int found = 0, done = 0;
+            start = now();
+            do {
+                for (unsigned int end = done + 1024; done < end; ++done) {
+                    found += parser->lookup(doc, lookups[done].table, lookups[done].key);
+                }
+                elapsed = now() - start;
+            } while (done < LOOKUPS && elapsed < LOOKUP_BUDGET);
+            parser->free(doc);
+            if (found != done) {
+                fprintf(stderr, "%s: found %u of %u keys\n", parser->name, found, done);
+                exit(1);
+            }
+            printf("  %-22s %10.1f %12.1f %12zu %10.2f\n",
+                parser->name,
+                (double)text->len / best * 1e9 / (1024 * 1024),
+                elapsed / done,
+                peak / 1024,
+                (double)peak / (double)text->len
+            );
+        }
+    }
+}
+
+int main(void) {
+    const corpus_t corpora[] = {
+        { "small",  8,     8  },
+        { "medium", 500,   20 },
+        { "large",  20000, 20 },
+        { "wide",   4,     20000 },
+    };
+    printf("%s\n", BENCH_PEAK_NOTE);
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(*corpora); ++c) {
+        text_t text = {0};
+        gen_corpus(&text, &corpora[c]);
+        lookup_t *lookups = gen_lookups(&corpora[c]);
+        printf("%s: %u tables, %u keys each, %zu bytes\n", corpora[c].name, corpora[c].tables, corpora[c].keys, text.len);
+        printf("  %-22s %10s %12s %12s %10s\n", "parser", "MB/s", "ns/lookup", "peak KB", "peak/byte");
+        for (size_t p = 0; p < sizeof(parsers) / sizeof(*parsers); ++p) {
+            bench(&parsers[p], &text, lookups);
+        }
+        free(lookups);
+        free(text.buf);
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+// worst case inputs for the parser. every case is parsed at two sizes, 8x
+// apart, and the time per byte of the two is compared: a linear parser takes
+// about the same time per byte at both sizes, a quadratic one takes ~8x as
+// long per byte on the big input, which fails the run
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define INI_IMPLEMENTATION
+#include "../ini.h"
+
+#define SCALE        8
+#define MAX_RATIO    3.0
+#define RUNS         5
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+} text_t;
+
+static void put(text_t *t, const void *data, size_t len) {
+    if (t->len + len > t->cap) {
+        while (t->len + len > t->cap) t->cap = t->cap ? t->cap * 2 : 4096;
+        t->buf = realloc(t->buf, t->cap);
+        if (!t->buf) { fprintf(stderr, "out of memory\n"); exit(1); }
+    }
+    memcpy(t->buf + t->len, data, len);
+    t->len += len;
+}
+
+static void putf(text_t *t, const char *fmt, int n) {
+    char tmp[64];
+    put(t, tmp, (size_t)snprintf(tmp, sizeof(tmp), fmt, n));
+}
+
+static void put_rep(text_t *t, const char *s, int n) {
+    size_t len = strlen(s);
+    for (int i = 0; i < n; ++i) put(t, s, len);
+}
+
+// the same table over and over, merged into one
+static void gen_same_tables(text_t *t, int n) {
+    for (int i = 0; i < n; ++i) {
+        put_rep(t, "[same]\n", 1);
+        putf(t, "key%d = value\n\n", i);
+    }
+}
+
+// the same key over and over, each one overriding the last
+static void gen_same_keys(text_t *t, int n) {
+    put_rep(t, "[table]\n", 1);
+    for (int i = 0; i < n; ++i) putf(t, "key = %d\n", i);
+}
+
+// a single line without a newline at the end
+static void gen_long_line(text_t *t, int n) {
+    put_rep(t, "key = ", 1);
+    put_rep(t, "xxxxxxxxxxxxxxxx", n);
+}
+
+// a single value made only of escaped comment characters
+static void gen_escapes(text_t *t, int n) {
+    put_rep(t, "key = ", 1);
+    put_rep(t, "\\#\\#\\#\\#\\#\\#\\#\\#", n);
+    put_rep(t, "\n", 1);
+}
+
+// keys that only differ after a long common prefix
+static void gen_prefix_keys(text_t *t, int n) {
+    put_rep(t, "[table]\n", 1);
+    for (int i = 0; i < n; ++i) {
+        put_rep(t, "prefix_prefix_prefix_prefix_prefix_prefix_prefix_prefix_", 4);
+        putf(t, "%d = 1\n", i);
+    }
+}
+
+// keys built to collide in the hash, see collision_words
+#define BLOCKS 20
+static uint64_t collide[BLOCKS][2][2];
+
+static void gen_collisions(text_t *t, int n) {
+    put_rep(t, "[table]\n", 1);
+    for (int i = 0; i < n; ++i) {
+        for (int b = 0; b < BLOCKS; ++b) {
+            put(t, collide[b][(i >> b) & 1], 16);
+        }
+        put_rep(t, " = 1\n", 1);
+    }
+}
+
+static uint64_t mul_inverse(uint64_t k) {
+    uint64_t inv = k;
+    for (int i = 0; i < 5; ++i) inv *= 2 - k * inv;
+    return inv;
+}
+
+static uint64_t unmix(uint64_t h) {
+    // inverse of the murmur3 finalizer used by ini__hash_mix
+    h ^= h >> 33;
+    h *= mul_inverse(0xc4ceb9fe1a85ec53ULL);
+    h ^= h >> 33;
+    h *= mul_inverse(0xff51afd7ed558ccdULL);
+    h ^= h >> 33;
+    return h;
+}
+
+static int usable_word(uint64_t word) {
+    unsigned char bytes[8];
+    memcpy(bytes, &word, 8);
+    for (int i = 0; i < 8; ++i) {
+        if (bytes[i] < 0x21 || bytes[i] == 0x7f || strchr("=[]#;\\\"'", bytes[i])) return 0;
+    }
+    return 1;
+}
+
+// an unseeded hash that xors mix(word) into its state and multiplies by an odd
+// constant is broken by words whose mixes only differ in the top bit: that bit
+// goes through the multiplication unchanged and the next pair of words flips it
+// back. every 16 byte block of a key is one of two such pairs, so all keys of
+// the same length collide whatever the seed is
+static void collision_words(void) {
+    uint64_t x = 0x0123456789abcdefULL;
+    for (int b = 0; b < BLOCKS; ++b) {
+        for (int w = 0; w < 2; ++w) {
+            uint64_t a, c;
+            do {
+                x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+                a = unmix(x);
+                c = unmix(x ^ (1ULL << 63));
+            } while (!usable_word(a) || !usable_word(c));
+            memcpy(&collide[b][0][w], &a, 8);
+            memcpy(&collide[b][1][w], &c, 8);
+        }
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*gen)(text_t *t, int n);
+    int n;
+    iniopts_t opts;
+} bench_case_t;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static double ns_per_byte(const bench_case_t *c, int n) {
+    text_t t = {0};
+    c->gen(&t, n);
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        double start = now();
+        ini_t ini = ini_parse_buf(t.buf, t.len, &c->opts);
+        double elapsed = now() - start;
+        if (ini.error != INI_NO_ERR) {
+            fprintf(stderr, "%s: %s\n", c->name, ini_explain(ini.error));
+            exit(1);
+        }
+        ini_free(&ini);
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    free(t.buf);
+    return best / (double)t.len;
+}
+
+int main(void) {
+    collision_words();
+    const bench_case_t cases[] = {
+        { "same tables, merged",   gen_same_tables, 20000, { .merge_duplicate_tables = true } },
+        { "same keys, overridden", gen_same_keys,   20000, { .override_duplicate_keys = true } },
+        { "long line",             gen_long_line,   65536, {0} },
+        { "escaped comments",      gen_escapes,     16384, {0} },
+        { "common prefix keys",    gen_prefix_keys, 5000,  { .lookup_index = true } },
+        { "colliding keys",        gen_collisions,  2000,  { .lookup_index = true } },
+    };
+    int failed = 0;
+    printf("%-24s %12s %12s %8s\n", "case", "ns/byte", "ns/byte x8", "ratio");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+        const bench_case_t *c = &cases[i];
+        double small = ns_per_byte(c, c->n);
+        double big = ns_per_byte(c, c->n * SCALE);
+        double ratio = big / small;
+        printf("%-24s %12.3f %12.3f %8.2f%s\n", c->name, small, big, ratio, ratio > MAX_RATIO ? "  <- superlinear" : "");
+        if (ratio > MAX_RATIO) failed = 1;
+    }
+    return failed;
+}
@@ -22,6 +22,166 @@
          - override_duplicate_keys
         the default key/value divider is '=', if you want to change is use
          - key_value_divider
+        to get every value of a duplicate key, in file order, use ini_get_all:
+            iniiter_t it = ini_get_all(ini_get_table(&ini, "upstream"), "server");
+            for (inivalue_t *v = ini_iter_next(&it); v; v = ini_iter_next(&it)) { ... }
+        the same goes for duplicate tables when merge_duplicate_tables is false:
+            initableiter_t it = ini_table_iter(&ini, "server");
+            for (initable_t *t = ini_table_next(&it); t; t = ini_table_next(&it)) { ... }
+        if you only care about a few tables, you can tell the parser which
+        ones to keep, every other table is skipped without being tokenized.
+        the root table is always parsed:
+         - only_tables: NULL terminated list of names, a name ending with '*'
+           matches every table that starts with that prefix
+         - table_filter: called with the name of every table, return true
+           to parse it, userdata is passed along
+        the same can be done for single keys, only the listed (table, key)
+        pairs are kept, the others are dropped while parsing:
+         - only_keys: list of inikeysel_t terminated by an entry with a NULL
+           key, use INI_ROOT as the table for keys in the root table
+        documents can share the memory of their table names and keys (and
+        optionally values) with an intern pool, the same string is only ever
+        stored once in it so interned strings can be compared by pointer:
+         - intern_pool: pointer to a inipool_t that must outlive the documents,
+           it is not thread safe
+         - intern_values: also intern values, this way the document doesn't 
+           need its text anymore and frees it right after parsing, without
+           the text it can't be checked against a cache so it's never cached
+        to reuse documents parsed before from the same text:
+         - cache: pointer to a inicache_t, it is not thread safe
+        ini_fingerprint hashes the whole text the first time it's called, to
+        hash each line right after it's parsed instead, in the same pass:
+         - fingerprint: nothing to do with a cache, which needs the hash
+           before parsing
+        ini_parse_buf and ini_parse_str copy the buffer, so that the document
+        owns it and it has INI_PADDING bytes after its end, to skip the copy:
+         - borrow_buffer: the buffer is used as is, it must outlive the document
+           and be followed by INI_PADDING readable bytes. such documents are
+           never added to a cache
+        for files that can't be trusted there are limits, 0 means no limit.
+        when one is hit parsing stops and ini_t.error says which one:
+         - max_bytes, max_tables, max_keys, max_table_keys, max_line_length
+         - cancel: called with userdata every INI_CANCEL_INTERVAL bytes,
+           return true to stop (e.g. after a deadline)
+        tables without an index are searched by comparing every key, which
+        means reading the text for each of them, to keep a copy of keys up to
+        15 bytes next to the values and compare them without touching the text:
+         - inline_keys
+        every table has its own vector of values, to put all of them in a single
+        block, in table order, once parsing is done (ini_parse_into always does):
+         - contiguous_values: tables.values and ivec_len work as usual for reading,
+           but the document is read only, like clones: the vectors live inside
+           a shared block and can't grow, so never push into them. this is
+           not a flat array of values, every table's vector keeps its 8 byte
+           header in front of it. table.first is the position its first value
+           would have in one, to index arrays of your own with value_count items
+        ini_get, ini_get_table and the iterators go through every key (or table)
+        until they find the one they want, for big tables or a lot of tables
+        a hash index makes them constant time, at the cost of building it
+        while parsing. merge_duplicate_tables and override_duplicate_keys
+        always build the one they need:
+         - lookup_index: index the list of tables and every table with at least
+           8 keys
+        ini_query finds every value that matches a table and a key pattern,
+        patterns with a fixed prefix (e.g. limit.*) can use a sorted index
+        instead of going through every key:
+         - sorted_index: also keep table names and keys of bigger tables sorted
+
+    access stats:
+        if INI_ACCESS_STATS is defined (in every file that includes ini.h)
+        every value found through ini_get and ini_iter_next gets its access
+        counter incremented, ini_access_report then calls a function for every
+        value with how many times it was read, unused keys have a count of 0.
+        when it is not defined none of this is compiled
+
+    clones:
+        ini_clone returns a new document that shares the text and the tables
+        with <ctx>, only the list of tables is copied. shared data is freed
+        when the last document using it is freed, clones are read only
+            ini_t req = ini_clone(&base);
+            ...
+            ini_free(&req);
+
+    slots:
+        register the keys you care about once and get back an id for each,
+        after every parse ini_slots_bind fills the slots with the values (and
+        their conversions), so reading a key is just an array access. the
+        generation of a slot goes up every time its value changes
+            inislots_t slots = {0};
+            int port = ini_slots_add(&slots, "server", "port");
+            ...
+            ini_slots_bind(&slots, &ini);
+            if (slots.slots[port].changed) restart(slots.slots[port].as_int);
+            ...
+            ini_slots_free(&slots);
+
+    subscriptions:
+        subscribe to a key, or to a whole table with a NULL key, and ini_notify
+        calls you back only when it changed between two versions of a document.
+        every table keeps a hash of its content, so unchanged tables are
+        skipped without looking at their values
+            inisubs_t subs = {0};
+            ini_subscribe(&subs, "server", "port", on_port_change, NULL);
+            ...
+            ini_t new_ini = ini_parse("file.ini", NULL);
+            ini_notify(&subs, &old_ini, &new_ini);
+            ...
+            ini_subs_free(&subs);
+
+    tracing:
+        if INI_USDT is defined, USDT probes are added at parse start/end, file
+        reads, table creation, index builds and lookup hits/misses, see the
+        list next to INI__PROBE1 below
+
+    fixed memory:
+        ini_parse_into never allocates, tables and values are stored in the
+        memory you give it and the buffer is not copied:
+            static char mem[64 * 1024];
+            ini_t ini = ini_parse_into(buf, buflen, mem, sizeof(mem), NULL);
+            if (!ini_is_valid(&ini)) needed = ini_parse_into_size(buf, buflen, NULL);
+
+    cache:
+        when a lot of files have the same content, a cache can skip parsing
+        them again. documents parsed with the same cache, the same text and the
+        same options share their data and are read only, like clones
+            inicache_t cache = {0};
+            cache.max_bytes = 64 * 1024 * 1024;
+            ini_t tenant = ini_parse(path, &(iniopts_t){ .cache = &cache });
+            ...
+            ini_free(&tenant);
+            ini_cache_free(&cache);
+
+    deltas:
+        a delta overrides or removes a few keys of a document without touching
+        it, lookups check the delta first and then the document. it lives on the
+        stack and never allocates, so there is nothing to free. the strings
+        are not copied, they must outlive the delta
+            inidelta_t delta = ini_delta(&base);
+            ini_delta_set(&delta, "server", "port", "8081");
+            ini_delta_remove(&delta, INI_ROOT, "name");
+            long long port = ini_as_int(ini_delta_get(&delta, "server", "port"));
+
+    bundles:
+        a bundle packs a lot of documents into a single file, with one string
+        pool shared by all of them and a directory to find them by name.
+        opening it maps the file in memory and getting a document only builds
+        its tables, there is no text to parse. the documents point into the
+        bundle, so it must outlive them
+            ini_bundle_write("tenants.bundle", names, docs, count);
+            inibundle_t bundle = ini_bundle_open("tenants.bundle");
+            ini_t tenant = ini_bundle_get(&bundle, "tenant-42");
+            ...
+            ini_free(&tenant);
+            ini_bundle_close(&bundle);
+
+    layout:
+        ini_optimize_layout moves the most used values and tables first, so
+        lookups on the hot path touch as little memory as possible. the counts
+        can come from the access stats or from a profile saved with
+        ini_write_profile in a previous run:
+            ini_t profile = ini_parse("profile.ini", NULL);
+            ini_optimize_layout(&ini, &profile);
+            ini_free(&profile);
 
     usage:
     - simple file:
@@ -70,9 +230,17 @@
 #include <stddef.h>
 #include <stdio.h>
 
+#ifndef INI_MALLOC
+// every allocation goes through these, define all three to use your own allocator
+// (e.g. to count allocations), strings returned by ini_as_str must then be freed with INI_FREE
+#define INI_MALLOC(size)                malloc(size)
+#define INI_REALLOC(ptr, size)          realloc(ptr, size)
+#define INI_FREE(ptr)                   free(ptr)
+#endif
+
 #define inivec_t(T)                     T *
 
-#define ivec_free(vec)                  ((vec) ? free(ini__vec_header(vec)), NULL : NULL)
+#define ivec_free(vec)                  ((vec) ? INI_FREE(ini__vec_header(vec)), NULL : NULL)
 #define ivec_copy(src, dest)            (ivec_free(dest), ivec_reserve(dest, ivec_len(src)), memcpy(dest, src, ivec_len(src)))
 
 #define ivec_push(vec, ...)             (ini__vec_may_grow(vec, 1), (vec)[ini__vec_len(vec)] = (__VA_ARGS__), ini__vec_len(vec)++)
@@ -95,32 +263,221 @@ typedef struct {
     size_t len;
 } inistrv_t;
 
+typedef enum {
+    INI_NO_ERR = 0,
+    INI_INVALID_ARGS = -1,
+    INI_BUFFER_TOO_SMALL = -2,
+    INI_IO_ERR = -3,
+    INI_LIMIT_BYTES = -4,
+    INI_LIMIT_TABLES = -5,
+    INI_LIMIT_KEYS = -6,
+    INI_LIMIT_TABLE_KEYS = -7,
+    INI_LIMIT_LINE = -8,
+    INI_CANCELLED = -9,
+    INI_OUT_OF_MEMORY = -10,
+} inierr_t;
+
 typedef struct {
     inistrv_t key;
     inistrv_t value;
 } inivalue_t;
 
+// lookup index, only built for bigger tables:
+// slots is an open addressing hash table storing the last item with a given
+// name (+1), chain links every item to the next one with the same name
+// in file order, with the last one pointing back to the first
+// sorted is optional, it has the items in name order and is used by ini_query
+typedef struct {
+    inivec_t(unsigned int) slots;
+    inivec_t(unsigned int) chain;
+    inivec_t(unsigned int) sorted;
+} iniindex_t;
+
+// copy of a key short enough to be compared with two 8 byte loads,
+// len is 0xff for keys that don't fit
+typedef struct {
+    char buf[15];
+    unsigned char len;
+} inishortkey_t;
+
 typedef struct {
     inistrv_t name;
     inivec_t(inivalue_t) values;
+    inivec_t(inishortkey_t) short_keys; // one per value, only with inline_keys and no index
+    iniindex_t index;
+    uint64_t hash; // hash of all the keys and values, doesn't depend on their order
+    unsigned int first; // position of values[0] if every value of the document was numbered in order
+#ifdef INI_ACCESS_STATS
+    inivec_t(unsigned int) hits; // one counter per value
+#endif
 } initable_t;
 
+// reference counted text and tables, shared between a document and its clones
+typedef struct ini__storage_t ini__storage_t;
+
 typedef struct {
     char *text;
     inivec_t(initable_t) tables;
+    iniindex_t index;
+    ini__storage_t *storage;
+    uint64_t fingerprint; // hash of the text, 0 until ini_fingerprint needs it (or with opts.fingerprint/cache)
+    size_t textlen;
+    unsigned int value_count; // sum of the values of every table
+    bool fixed;           // tables and values live in the memory given to ini_parse_into
+    inierr_t error;       // why parsing failed, INI_NO_ERR if it didn't
 } ini_t;
 
+typedef struct {
+    const char *table; // INI_ROOT for the root table
+    const char *key;
+} inikeysel_t;
+
+// strings are never moved once interned, a zero initialized pool is valid
+typedef struct {
+    inivec_t(char *) blocks;
+    size_t block_used;
+    size_t block_cap;
+    inivec_t(inistrv_t) strings;
+    iniindex_t index;
+} inipool_t;
+
+typedef struct {
+    uint64_t fingerprint;
+    uint64_t opts_hash;
+    size_t textlen;
+    size_t bytes;
+    unsigned long long last_use;
+    ini_t doc;
+} inicacheentry_t;
+
+// a zero initialized inicache_t is valid and has no limits
+typedef struct {
+    inivec_t(inicacheentry_t) entries;
+    size_t max_entries; // 0 means no limit
+    size_t max_bytes;   // 0 means no limit, documents bigger than this are never cached
+    size_t bytes;
+    unsigned long long clock;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+} inicache_t;
+
 typedef struct {
     bool merge_duplicate_tables;  // default: false
     bool override_duplicate_keys; // default: false
     char key_value_divider;       // default: =
+    const char **only_tables;     // default: NULL (parse every table)
+    bool (*table_filter)(inistrv_t name, void *userdata); // default: NULL
+    void *userdata;               // default: NULL
+    const inikeysel_t *only_keys; // default: NULL (keep every key)
+    inipool_t *intern_pool;       // default: NULL
+    bool intern_values;           // default: false
+    bool sorted_index;            // default: false
+    bool lookup_index;            // default: false
+    inicache_t *cache;            // default: NULL
+    bool borrow_buffer;           // default: false
+    bool inline_keys;             // default: false
+    bool contiguous_values;       // default: false
+    bool fingerprint;             // default: false
+    // limits, 0 means no limit. when one is hit parsing stops and the
+    // document is invalid, with the reason in ini_t.error
+    size_t max_bytes;             // default: 0
+    unsigned int max_tables;      // default: 0, not counting root
+    unsigned int max_keys;        // default: 0, in the whole document
+    unsigned int max_table_keys;  // default: 0
+    size_t max_line_length;       // default: 0
+    // called every INI_CANCEL_INTERVAL bytes with userdata, return true to stop
+    bool (*cancel)(void *userdata); // default: NULL
 } iniopts_t;
 
-typedef enum {
-    INI_NO_ERR = 0,
-    INI_INVALID_ARGS = -1,
-    INI_BUFFER_TOO_SMALL = -2,
-} inierr_t;
+typedef struct {
+    initable_t *table;
+    inistrv_t key;
+    unsigned int first;
+    unsigned int cur;
+} iniiter_t;
+
+typedef struct {
+    ini_t *ini;
+    unsigned int first;
+    unsigned int cur;
+} initableiter_t;
+
+typedef struct {
+    inivalue_t *value; // NULL if the key is not in the document
+    long long as_int;
+    double as_num;
+    bool as_bool;
+    bool changed;      // if the value changed in the last bind
+    unsigned int generation;
+    uint64_t hash;
+} inislot_t;
+
+// a zero initialized inislots_t is valid
+typedef struct {
+    inivec_t(inikeysel_t) keys;
+    inivec_t(inislot_t) slots;
+} inislots_t;
+
+// <key> is empty for table subscriptions, <old_value> is NULL if the key was added
+// and <new_value> is NULL if it was removed
+typedef void (*inisub_fn)(inistrv_t table, inistrv_t key, const inivalue_t *old_value, const inivalue_t *new_value, void *userdata);
+
+typedef struct {
+    inistrv_t table;
+    inistrv_t key;
+    uint64_t hash;
+    inisub_fn fn;
+    void *userdata;
+} inisub_t;
+
+// a zero initialized inisubs_t is valid
+typedef struct {
+    inivec_t(inisub_t) subs;
+    inivec_t(unsigned int) slots;
+    unsigned int calls;
+} inisubs_t;
+
+#ifndef INI_PADDING
+// every text buffer owned by the parser (files, copied buffers, intern pools
+// and bundle strings) is followed by at least this many readable zero bytes,
+// strings returned by ini_as_str only have their null terminator
+#define INI_PADDING 64
+#endif
+#if INI_PADDING < 1
+#error "INI_PADDING must be at least 1, for the null terminator"
+#endif
+
+#ifndef INI_CANCEL_INTERVAL
+// how many bytes are parsed between two calls to iniopts_t.cancel
+#define INI_CANCEL_INTERVAL (64 * 1024)
+#endif
+
+#ifndef INI_DELTA_SLOTS
+// number of slots in a delta, must be a power of two and at most 64,
+// only 3/4 of them can be used
+#define INI_DELTA_SLOTS 16
+#endif
+
+typedef struct {
+    uint64_t hash;
+    inistrv_t table;
+    inivalue_t value;
+    bool removed;
+} inideltaentry_t;
+
+typedef struct {
+    ini_t *base;
+    uint64_t used; // one bit per slot, so that creating a delta doesn't need to clear it
+    unsigned int count;
+    inideltaentry_t slots[INI_DELTA_SLOTS];
+} inidelta_t;
+
+typedef struct {
+    const char *data;
+    size_t size;
+    bool mapped;
+} inibundle_t;
 
 #define INI_ROOT NULL
 
@@ -130,20 +487,56 @@ ini_t ini_parse(const char *filename, const iniopts_t *options);
 ini_t ini_parse_str(const char *ini_str, const iniopts_t *options);
 // parses a ini buffer, this buffer *can* contain '\0', if options is NULL it uses the default options
 ini_t ini_parse_buf(const char *buf, size_t buflen, const iniopts_t *options);
-// parses a ini file from a file descriptor, if options is NULL it uses the default options
+// parses a ini file from a file descriptor, if options is NULL it uses the default options.
+// it reads from the current position until the end, so it also works with pipes and stdin,
+// on posix it reads the file descriptor directly so nothing should have been read from <fp> before
 ini_t ini_parse_fp(FILE *fp, const iniopts_t *options);
+// parses a ini buffer without allocating anything, every table and value is stored in <mem>.
+// the buffer is not copied so it must outlive the document. merge_duplicate_tables, only_keys,
+// intern_pool, cache, sorted_index, inline_keys and lookup_index need the heap, so they can't be used here.
+// lookups (ini_get, ini_get_table and the iterators) and conversions (ini_as_int, ini_as_uint, 
+// ini_as_num, ini_as_bool, ini_to_str, ini_to_array) never allocate, without an index they 
+// are linear in the number of tables/values.
+// the document is read only, its vectors live in <mem> and can't grow.
+// returns an invalid document if <mem> is too small, ini_free on the document only clears it
+ini_t ini_parse_into(const char *buf, size_t buflen, void *mem, size_t memlen, const iniopts_t *options);
+// returns how many bytes of memory ini_parse_into needs for <buf>, or 0 if the options are not supported
+size_t ini_parse_into_size(const char *buf, size_t buflen, const iniopts_t *options);
 // checks that the ini file has been parsed correctly
 bool ini_is_valid(ini_t *ctx);
 void ini_free(ini_t *ctx);
+// returns a 64 bit hash of the text that <ctx> was parsed from, it is computed while
+// parsing with the fingerprint option, otherwise the first time it's needed, then it
+// is free to call. returns 0 if the text wasn't kept (intern_values) and it wasn't
+// computed while parsing
+uint64_t ini_fingerprint(ini_t *ctx);
+// returns a 64 bit hash of the tables, keys and values of <ctx>, ignoring comments,
+// whitespace and the order of keys and tables
+uint64_t ini_semantic_fingerprint(ini_t *ctx);
+// returns a read only copy of <ctx> that shares its text and tables, only the 
+// list of tables is copied, it must be freed with ini_free like any other document
+ini_t ini_clone(ini_t *ctx);
 
 // return a table with name <name>, returns NULL if nothing was found
 initable_t *ini_get_table(ini_t *ctx, const char *name);
 // return a value with key <key>, returns NULL if nothing was found or if <ctx> is NULL
 inivalue_t *ini_get(initable_t *ctx, const char *key);
+// return an iterator over every value with key <key>, in file order, 
+// only useful when override_duplicate_keys is false. with lookup_index every step is O(1)
+iniiter_t ini_get_all(initable_t *ctx, const char *key);
+// return the next value of the iterator, or NULL when there are no more
+inivalue_t *ini_iter_next(iniiter_t *it);
+// return an iterator over every table with name <name>, in file order,
+// only useful when merge_duplicate_tables is false. with lookup_index every step is O(1)
+initableiter_t ini_table_iter(ini_t *ctx, const char *name);
+// return the next table of the iterator, or NULL when there are no more
+initable_t *ini_table_next(initableiter_t *it);
 
 // returns an allocated vector of values divided by <delim>
 // if <delim> is 0 then it defaults to ' ', must be freed with ivec_free
 inivec_t(inistrv_t) ini_as_array(const inivalue_t *value, char delim);
+// number conversions never read past the end of the value (only its first 127 bytes),
+// they return 0 if it isn't a number or it doesn't fit
 unsigned long long ini_as_uint(const inivalue_t *value);
 long long ini_as_int(const inivalue_t *value);
 double ini_as_num(const inivalue_t *value);
@@ -165,6 +558,88 @@ inierr_t ini_to_str(const inivalue_t *value, char *buf, size_t buflen, bool remo
 // returns a human readable version of <error>
 const char *ini_explain(inierr_t error);
 
+typedef void (*iniquery_fn)(initable_t *table, inivalue_t *value, void *userdata);
+// calls <fn> for every value with a key matching <key_glob> in every table matching
+// <table_glob>, patterns can use '*' (any number of characters) and '?' (any character), 
+// use INI_ROOT for the root table. the order of the values is not specified
+// returns the number of matching values
+unsigned int ini_query(ini_t *ctx, const char *table_glob, const char *key_glob, iniquery_fn fn, void *userdata);
+
+// registers <key> in <table> (INI_ROOT for the root table) and returns its slot id,
+// the strings are not copied so they must outlive <slots>
+int ini_slots_add(inislots_t *slots, const char *table, const char *key);
+// fills every slot with its value from <ctx>, slots stay valid as long as <ctx> is
+// returns the number of slots that changed since the last bind
+unsigned int ini_slots_bind(inislots_t *slots, ini_t *ctx);
+void ini_slots_free(inislots_t *slots);
+
+// calls <fn> every time <key> in <table> (INI_ROOT for the root table) changes,
+// if <key> is NULL it is called once every time anything in <table> changes.
+// a [root] section is a table like any other, subscribe to it as "root".
+// the strings are not copied so they must outlive <subs>
+// returns INI_NO_ERR on success or <0 on failure (check inierr_t)
+inierr_t ini_subscribe(inisubs_t *subs, const char *table, const char *key, inisub_fn fn, void *userdata);
+// compares <old_ctx> and <new_ctx> and calls the subscribers of what changed,
+// either of them can be NULL (e.g. on the first load), documents with a lot of
+// tables should be parsed with lookup_index, otherwise every table is found linearly
+// returns the number of callbacks called
+unsigned int ini_notify(inisubs_t *subs, ini_t *old_ctx, ini_t *new_ctx);
+void ini_subs_free(inisubs_t *subs);
+
+// returns the interned copy of <str>, which is valid until the pool is freed,
+// two equal strings interned in the same pool always have the same pointer.
+// returns NULL if the string couldn't be allocated
+const char *ini_intern(inipool_t *pool, const char *str);
+void ini_pool_free(inipool_t *pool);
+
+// frees every document in the cache, the ones that were returned by a parse
+// stay valid until they are freed
+void ini_cache_free(inicache_t *cache);
+
+// writes <count> documents in a bundle file, <names> are the names used to
+// get them back with ini_bundle_get, the file uses the native endianness
+// returns INI_NO_ERR on success or <0 on failure (check inierr_t)
+inierr_t ini_bundle_write(const char *filename, const char **names, ini_t *docs, unsigned int count);
+// maps a bundle file in memory, check that it worked with ini_bundle_is_valid
+inibundle_t ini_bundle_open(const char *filename);
+bool ini_bundle_is_valid(inibundle_t *bundle);
+// returns the document called <name>, its strings point inside of the bundle
+// so it must be freed (with ini_free) before closing the bundle
+ini_t ini_bundle_get(inibundle_t *bundle, const char *name);
+void ini_bundle_close(inibundle_t *bundle);
+
+// returns an empty delta on top of <base>
+inidelta_t ini_delta(ini_t *base);
+// overrides <key> in <table> (INI_ROOT for the root table) with <value>, the 
+// strings are not copied so they must outlive the delta
+// returns INI_NO_ERR on success or <0 on failure (check inierr_t)
+inierr_t ini_delta_set(inidelta_t *delta, const char *table, const char *key, const char *value);
+// hides <key> in <table> (INI_ROOT for the root table)
+// returns INI_NO_ERR on success or <0 on failure (check inierr_t)
+inierr_t ini_delta_remove(inidelta_t *delta, const char *table, const char *key);
+// return the value of <key> in <table> from the delta or, if it wasn't changed,
+// from the base document, returns NULL if nothing was found or if it was removed
+inivalue_t *ini_delta_get(inidelta_t *delta, const char *table, const char *key);
+
+// reorders the values of each table, and the tables themselves, so that the most
+// accessed ones come first, the root table always stays first and duplicate
+// keys/tables keep their relative order. the counts are read from <profile>,
+// which has the same tables as <ctx> and the access count as the value of each key,
+// if <profile> is NULL it uses the access stats (INI_ACCESS_STATS).
+// clones, documents that are shared with a clone and documents from ini_parse_into
+// can't be reordered
+// returns INI_NO_ERR on success or <0 on failure (check inierr_t)
+inierr_t ini_optimize_layout(ini_t *ctx, ini_t *profile);
+
+#ifdef INI_ACCESS_STATS
+typedef void (*iniaccess_fn)(const initable_t *table, const inivalue_t *value, unsigned int count, void *userdata);
+// calls <fn> for every value in every table with the number of times it was accessed
+void ini_access_report(ini_t *ctx, iniaccess_fn fn, void *userdata);
+// writes the access stats as an ini file that can be used with ini_optimize_layout
+// returns INI_NO_ERR on success or <0 on failure (check inierr_t)
+inierr_t ini_write_profile(ini_t *ctx, FILE *fp);
+#endif
+
 #endif
 
 #ifdef INI_IMPLEMENTATION
@@ -176,6 +651,34 @@ const char *ini_explain(inierr_t error);
 #include <assert.h>
 #include <ctype.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define INI__POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+// fileno and posix_fadvise are hidden in strict iso c mode
+#if defined(__APPLE__) || defined(_POSIX_C_SOURCE)
+#define INI__POSIX_IO
+#endif
+#endif
+
+// USDT probes, provider "ini", they are a single nop until a tracer attaches:
+//   parse_start(bytes), parse_done(bytes, tables, error), file_read(bytes),
+//   table_new(name, len), index_build(items, slots) when an index is built or grows,
+//   get_hit(key, table, table_len), get_miss(key, table, table_len)
+#ifdef INI_USDT
+#include <sys/sdt.h>
+#define INI__PROBE1(name, a)         DTRACE_PROBE1(ini, name, a)
+#define INI__PROBE2(name, a, b)      DTRACE_PROBE2(ini, name, a, b)
+#define INI__PROBE3(name, a, b, c)   DTRACE_PROBE3(ini, name, a, b, c)
+#else
+#define INI__PROBE1(name, a)         ((void)0)
+#define INI__PROBE2(name, a, b)      ((void)0)
+#define INI__PROBE3(name, a, b, c)   ((void)0)
+#endif
+
 #ifdef __cplusplus
 #define CDECL(type) type
 #else
@@ -190,9 +693,44 @@ const char *ini_explain(inierr_t error);
 #define ini__vec_may_grow(vec, n)    (ini__vec_need_grow(vec, (n)) ? ini__vec_grow(vec, (unsigned int)(n)) : (void)0)
 #define ini__vec_grow(vec, n)        ini__vec_grow_impl((void **)&(vec), (n), sizeof(*(vec)))
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ini__atomic_inc(ptr)         _InterlockedIncrement((volatile long *)(ptr))
+#define ini__atomic_dec(ptr)         _InterlockedDecrement((volatile long *)(ptr))
+#define ini__atomic_load(ptr)        (*(volatile long *)(ptr))
+#else
+#define ini__atomic_inc(ptr)         __atomic_fetch_add((ptr), 1, __ATOMIC_RELAXED)
+#define ini__atomic_dec(ptr)         __atomic_sub_fetch((ptr), 1, __ATOMIC_ACQ_REL)
+#define ini__atomic_load(ptr)        __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#endif
+
+#ifdef INI_ACCESS_STATS
+#define ini__count_access(tab, pos)  ((pos) < ivec_len((tab)->hits) ? (void)ini__atomic_inc(&(tab)->hits[pos]) : (void)0)
+#else
+#define ini__count_access(tab, pos)  ((void)0)
+#endif
+
+#ifndef INI_HASH_SEED
+// seed of the lookup indexes, the address of a static changes with every run when
+// aslr is on, so names that all collide can't be prepared in advance. define it
+// to a constant to get the same layout every time
+#define INI_HASH_SEED                ((uint64_t)(uintptr_t)&ini__default_opts)
+#endif
+
+#define INI__NONE                    UINT_MAX
+#define INI__VEC_MIN_CAP             8
+#define INI__LONG_KEY                0xff
+// tables with less values than this are simply searched linearly
+#define INI__INDEX_MIN               8
+// numbers are converted from a copy of at most this many bytes (with the terminator)
+#define INI__NUM_MAX                 128
+
 inline static void ini__vec_grow_impl(void **arr, unsigned int increment, unsigned int itemsize) {
+    // most vectors are the values of small tables, starting with a few items
+    // saves them a couple of reallocs each
     int newcap = *arr ? 2 * ini__vec_cap(*arr) + increment : increment + 1;
-    void *ptr = realloc(*arr ? ini__vec_header(*arr) : 0, itemsize * newcap + sizeof(unsigned int) * 2);
+    if (newcap < INI__VEC_MIN_CAP) newcap = INI__VEC_MIN_CAP;
+    void *ptr = INI_REALLOC(*arr ? ini__vec_header(*arr) : 0, itemsize * newcap + sizeof(unsigned int) * 2);
     assert(ptr);
     if (ptr) {
         if (!*arr) ((unsigned int *)ptr)[1] = 0;
@@ -205,23 +743,232 @@ static const iniopts_t ini__default_opts = {
     false, // merge_duplicate_tables
     false, // override_duplicate_keys
     '=',   // key_value_divider
+    NULL,  // only_tables
+    NULL,  // table_filter
+    NULL,  // userdata
+    NULL,  // only_keys
+    NULL,  // intern_pool
+    false, // intern_values
+    false, // sorted_index
+    false, // lookup_index
+    NULL,  // cache
+    false, // borrow_buffer
+    false, // inline_keys
+    false, // contiguous_values
+    false, // fingerprint
+    0,     // max_bytes
+    0,     // max_tables
+    0,     // max_keys
+    0,     // max_table_keys
+    0,     // max_line_length
+    NULL,  // cancel
 };
 
+static const inistrv_t ini__root_name = { "root", 4 };
+
 typedef struct {
     const char *start;
     const char *cur;
     size_t len;
 } ini__istream_t;
 
-static ini_t ini__parse_internal(char *text, size_t textlen, const iniopts_t *options);
-static char *ini__read_whole_file(FILE *fp, size_t *filelen);
+// open addressing set of hashes, used to check quickly if a table/key was
+// selected with only_keys, slots store the index of the selector + 1
+typedef struct {
+    inivec_t(unsigned int) keys;
+    inivec_t(unsigned int) tables;
+    const char *hashed_table;
+    uint64_t table_hash;
+} ini__keyset_t;
+
+// caller memory used by ini_parse_into, the first pass only counts (mem is NULL)
+// and the second one lays out the tables and values, the values of the last table
+// get all of the remaining memory until the next table starts
+typedef struct {
+    char *mem;
+    size_t cap;
+    size_t used;
+    unsigned int tables;      // not counting root
+    unsigned int values;      // not counting the root values
+    unsigned int root_values;
+    initable_t *open;
+    bool overflow;
+    initable_t scratch[2];    // root and the current table while counting
+} ini__arena_t;
+
+// ini__hash_bulk split in steps, so that the text can be hashed while it's parsed
+typedef struct {
+    uint64_t lanes[4];
+    uint64_t seed;
+    const unsigned char *start;
+    const unsigned char *next; // first byte that isn't hashed yet
+} ini__bulkhash_t;
+
+typedef struct {
+    iniopts_t opts;
+    ini__keyset_t keyset;
+    ini__arena_t *arena;      // only set by ini_parse_into
+    ini__bulkhash_t *hasher;  // only set with opts.fingerprint, hashes what was parsed so far
+    inierr_t error;           // set when a limit is hit, parsing stops right after
+    unsigned int tables;
+    unsigned int keys;
+    size_t next_check;        // position of the next call to opts.cancel
+} ini__parser_t;
+
+typedef struct {
+    uint64_t weight;
+    unsigned int pos;
+} ini__rank_t;
+
+// bundle file layout, every section is 8 byte aligned:
+// header | directory | documents | strings
+// strings are null terminated and only stored once, documents are a
+// ini__bundle_doc_t followed by their tables and values
+typedef struct {
+    char magic[8];
+    uint32_t doc_count;
+    uint32_t dir_cap;
+    uint64_t dir_off;
+    uint64_t strings_off;
+    uint64_t strings_len;
+} ini__bundle_header_t;
+
+typedef struct {
+    uint64_t hash;
+    uint64_t doc_off; // 0 if the slot is empty
+    uint32_t name_off;
+    uint32_t name_len;
+} ini__bundle_dir_t;
+
+typedef struct {
+    uint32_t table_count;
+    uint32_t value_count;
+} ini__bundle_doc_t;
+
+typedef struct {
+    uint32_t name_off;
+    uint32_t name_len;
+    uint32_t first;
+    uint32_t count;
+} ini__bundle_table_t;
+
+typedef struct {
+    uint32_t key_off;
+    uint32_t key_len;
+    uint32_t val_off;
+    uint32_t val_len;
+} ini__bundle_value_t;
+
+typedef struct {
+    inistrv_t str;
+    uint32_t off;
+} ini__bundle_str_t;
+
+typedef struct {
+    ini_t *ini;
+    initable_t *table;
+    inistrv_t key_glob;
+    iniquery_fn fn;
+    void *userdata;
+    unsigned int matches;
+} ini__query_t;
+
+typedef struct {
+    inistrv_t name;
+    unsigned int pos;
+} ini__sortkey_t;
+
+typedef struct {
+    inivec_t(char) strings;
+    inivec_t(ini__bundle_str_t) offsets;
+    iniindex_t index;
+} ini__bundle_writer_t;
+
+static const char ini__bundle_magic[8] = { 'I', 'N', 'I', 'B', 'N', 'D', 'L', '1' };
+
+struct ini__storage_t {
+    long refs;
+    char *text;
+    // the original tables and index, which own all of the values
+    inivec_t(initable_t) tables;
+    iniindex_t index;
+    // with contiguous_values, every vector of values lives in here
+    char *values;
+};
+
+static ini_t ini__parse_internal(char *text, size_t textlen, bool copy, const iniopts_t *options);
+static ini_t ini__parse_text(char *text, size_t textlen, bool copy, const iniopts_t *options);
+static ini_t ini__parse_fixed(const char *buf, size_t buflen, void *mem, size_t memlen, const iniopts_t *options);
+static void ini__free_tables(inivec_t(initable_t) tables, bool packed);
+static void ini__finalize(ini_t *ini, bool sorted_index, bool contiguous);
+static void ini__pack_values(ini_t *ini);
+static void ini__number_values(ini_t *ini);
+static void ini__parse_loop(ini_t *ini, const char *text, size_t textlen, ini__parser_t *p);
+static void ini__check_line(ini__parser_t *p, ini__istream_t *in, const char *line_start);
+static void ini__check_cancel(ini__parser_t *p, ini__istream_t *in);
+static bool ini__arena_check_opts(const iniopts_t *opts);
+static size_t ini__arena_count(const char *buf, size_t buflen, ini__parser_t *p, ini__arena_t *counter);
+static void *ini__arena_vec(ini__arena_t *arena, unsigned int cap, size_t itemsize);
+static void ini__arena_close(ini__arena_t *arena);
+static initable_t *ini__push_table(ini_t *ctx, initable_t table, ini__parser_t *p);
+static void ini__push_value(initable_t *table, inivalue_t value, ini__parser_t *p);
+static uint64_t ini__opts_hash(const iniopts_t *opts);
+static ini_t ini__cache_get(inicache_t *cache, uint64_t fingerprint, uint64_t opts_hash, const char *text, size_t textlen);
+static ini_t ini__cache_put(inicache_t *cache, ini_t *ini, uint64_t opts_hash, size_t textlen);
+static uint32_t ini__bundle_add_str(ini__bundle_writer_t *w, inistrv_t str);
+static inistrv_t ini__bundle_str(inibundle_t *bundle, uint32_t off, uint32_t len);
+static char *ini__read_whole_file(FILE *fp, size_t *filelen, size_t max_bytes, inierr_t *error);
+#ifdef INI__POSIX
+static char *ini__read_fd(int fd, size_t *filelen, size_t max_bytes, inierr_t *error);
+#endif
 static iniopts_t ini__set_default_opts(const iniopts_t *options);
 static initable_t *ini__find_table(ini_t *ctx, inistrv_t name);
+static bool ini__is_table_selected(inistrv_t name, ini__parser_t *p);
+static bool ini__is_key_selected(const initable_t *table, inistrv_t key, ini__parser_t *p);
 static inivalue_t *ini__find_value(initable_t *table, inistrv_t key);
-static void ini__add_table(ini_t *ctx, ini__istream_t *in, const iniopts_t *options);
-static void ini__add_value(initable_t *table, ini__istream_t *in, const iniopts_t *options);
+static unsigned int ini__find_value_pos(initable_t *table, inistrv_t key);
+static inishortkey_t ini__short_key(inistrv_t key);
+static bool ini__short_key_eq(const inishortkey_t *a, const inishortkey_t *b);
+static uint64_t ini__key_weight(ini_t *src, inistrv_t table_name, inistrv_t key, bool from_stats);
+static void ini__sort_values(ini_t *ctx, initable_t *table, ini_t *profile);
+static void ini__sort_tables(ini_t *ctx, ini_t *profile);
+static bool ini__group_has_key(ini_t *ctx, unsigned int first, unsigned int table, unsigned int value);
+static int ini__rank_cmp(const void *a, const void *b);
+static void ini__add_table(ini_t *ctx, ini__istream_t *in, ini__parser_t *p);
+static void ini__add_value(initable_t *table, ini__istream_t *in, ini__parser_t *p);
 static char *ini__strdup(const char *src, size_t len);
+static const char *ini__num_str(inistrv_t value, char *buf, size_t buflen);
+static char *ini__strdup_padded(const char *src, size_t len);
 static int ini__rem_escaped(inistrv_t value, char *buf, size_t buflen);
+static uint64_t ini__hash_mix(uint64_t h);
+static uint64_t ini__hash(const void *data, size_t len, uint64_t seed);
+static uint64_t ini__hash_bulk(const void *data, size_t len, uint64_t seed);
+static void ini__hash_bulk_init(ini__bulkhash_t *h, const void *data, uint64_t seed);
+static void ini__hash_bulk_feed(ini__bulkhash_t *h, const void *upto);
+static uint64_t ini__hash_bulk_end(ini__bulkhash_t *h, size_t len);
+static inistrv_t ini__intern(inipool_t *pool, inistrv_t str);
+static uint64_t ini__pair_hash(inistrv_t key, inistrv_t value);
+static unsigned int ini__group_first(ini_t *ctx, inistrv_t name);
+static unsigned int ini__group_step(ini_t *ctx, unsigned int t, unsigned int first);
+static uint64_t ini__group_hash(ini_t *ctx, unsigned int first);
+static inivalue_t *ini__group_get(ini_t *ctx, unsigned int first, inistrv_t key);
+static void ini__diff_group(inisubs_t *subs, ini_t *old_ctx, unsigned int old_first, ini_t *new_ctx, unsigned int new_first);
+static void ini__dispatch(inisubs_t *subs, inistrv_t table, inistrv_t key, const inivalue_t *old_value, const inivalue_t *new_value);
+static inideltaentry_t *ini__delta_find(inidelta_t *delta, inistrv_t table, inistrv_t key, bool insert);
+
+// index helper functions, items can be either initable_t or inivalue_t as
+// both start with their name (inistrv_t)
+static void index__push(iniindex_t *index, const void *items, size_t stride, unsigned int count);
+static unsigned int index__find(const iniindex_t *index, const void *items, size_t stride, unsigned int count, inistrv_t name);
+static unsigned int index__next(const iniindex_t *index, const void *items, size_t stride, unsigned int count, unsigned int pos);
+static void index__sort(iniindex_t *index, const void *items, size_t stride, unsigned int count);
+static void index__match(const iniindex_t *index, const void *items, size_t stride, unsigned int count, inistrv_t pattern, void (*fn)(unsigned int pos, void *udata), void *udata);
+static void index__free(iniindex_t *index);
+
+// key set helper functions
+static void keyset__init(ini__keyset_t *set, const inikeysel_t *sel);
+static void keyset__free(ini__keyset_t *set);
+static void keyset__insert(inivec_t(unsigned int) slots, uint64_t hash, unsigned int index);
 
 // string stream helper functions
 static ini__istream_t istr__init(const char *str, size_t len);
@@ -229,6 +976,7 @@ static bool istr__is_finished(ini__istream_t *in);
 static void istr__skip_whitespace(ini__istream_t *in);
 static void istr__ignore(ini__istream_t *in, char delim);
 static void istr__skip(ini__istream_t *in);
+static void istr__skip_table(ini__istream_t *in);
 static inistrv_t istr__get_view(ini__istream_t *in, char delim);
 
 // string view helper functions
@@ -237,54 +985,240 @@ static inistrv_t strv__trim(inistrv_t view);
 static inistrv_t strv__sub(inistrv_t view, size_t from, size_t to);
 static bool strv__is_empty(inistrv_t view);
 static int strv__cmp(inistrv_t a, inistrv_t b);
+static int strv__cmp_lex(inistrv_t a, inistrv_t b);
+static bool strv__glob(inistrv_t pattern, inistrv_t str);
+static bool strv__contains(inistrv_t str, inistrv_t sub);
 
 ini_t ini_parse(const char *filename, const iniopts_t *options) {
     if (!filename) return CDECL(ini_t){0};
-    FILE *fp = fopen(filename, "rb");
     size_t filelen = 0;
-    char *file_data = ini__read_whole_file(fp, &filelen);
-    fclose(fp);
-    return ini__parse_internal(file_data, filelen, options);
+    ini_t ini = {0};
+    // files bigger than max_bytes are rejected before reading them
+    size_t max_bytes = options ? options->max_bytes : 0;
+#ifdef INI__POSIX
+    int fd = open(filename, O_RDONLY);
+    char *file_data = ini__read_fd(fd, &filelen, max_bytes, &ini.error);
+    if (fd >= 0) close(fd);
+#else
+    FILE *fp = fopen(filename, "rb");
+    char *file_data = ini__read_whole_file(fp, &filelen, max_bytes, &ini.error);
+    if (fp) fclose(fp);
+#endif
+    if (ini.error) return ini;
+    return ini__parse_internal(file_data, filelen, false, options);
 }
 
 ini_t ini_parse_str(const char *ini_str, const iniopts_t *options) {
-    size_t ini_str_len = strlen(ini_str);
-    return ini__parse_internal(ini__strdup(ini_str, ini_str_len), ini_str_len, options);
+    return ini__parse_internal((char *)ini_str, strlen(ini_str), true, options);
 }
 
 ini_t ini_parse_buf(const char *buf, size_t buflen, const iniopts_t *options) {
-    return ini__parse_internal(ini__strdup(buf, buflen), buflen, options);
+    return ini__parse_internal((char *)buf, buflen, true, options);
 }
 
 ini_t ini_parse_fp(FILE *fp, const iniopts_t *options) {
     size_t filelen = 0;
-    char *file_data = ini__read_whole_file(fp, &filelen);
-    return ini__parse_internal(file_data, filelen, options);
+    ini_t ini = {0};
+    size_t max_bytes = options ? options->max_bytes : 0;
+    char *file_data = ini__read_whole_file(fp, &filelen, max_bytes, &ini.error);
+    if (ini.error) return ini;
+    return ini__parse_internal(file_data, filelen, false, options);
+}
+
+ini_t ini_parse_into(const char *buf, size_t buflen, void *mem, size_t memlen, const iniopts_t *options) {
+    INI__PROBE1(parse_start, buflen);
+    ini_t ini = ini__parse_fixed(buf, buflen, mem, memlen, options);
+    INI__PROBE3(parse_done, buflen, ivec_len(ini.tables), ini.error);
+    return ini;
+}
+
+static ini_t ini__parse_fixed(const char *buf, size_t buflen, void *mem, size_t memlen, const iniopts_t *options) {
+    ini_t ini = {0};
+    ini__parser_t p = {0};
+    p.opts = ini__set_default_opts(options);
+    if (!buf || !mem || !ini__arena_check_opts(&p.opts)) {
+        ini.error = INI_INVALID_ARGS;
+        return ini;
+    }
+    ini__arena_t counter = {0};
+    size_t needed = ini__arena_count(buf, buflen, &p, &counter);
+    if (p.error || needed > memlen) {
+        ini.error = p.error ? p.error : INI_BUFFER_TOO_SMALL;
+        return ini;
+    }
+
+    ini__arena_t arena = {0};
+    // every vector header and item is a multiple of 8 bytes
+    size_t skip = (8 - (uintptr_t)mem % 8) % 8;
+    arena.mem = (char *)mem + skip;
+    arena.cap = memlen - skip;
+    arena.tables = counter.tables;
+    arena.root_values = counter.root_values;
+    p.arena = &arena;
+    p.tables = p.keys = 0;
+    p.next_check = 0;
+    // only the second pass hashes the text
+    ini__bulkhash_t hasher;
+    if (p.opts.fingerprint) {
+        ini__hash_bulk_init(&hasher, buf, 0);
+        p.hasher = &hasher;
+    }
+
+    ini.text = (char *)buf;
+    ini.textlen = buflen;
+    ini.fixed = true;
+    ini.tables = (initable_t *)ini__arena_vec(&arena, arena.tables + 2, sizeof(initable_t));
+    initable_t root = {0};
+    root.name = ini__root_name;
+    root.values = (inivalue_t *)ini__arena_vec(&arena, arena.root_values + 1, sizeof(inivalue_t));
+    ivec_push(ini.tables, root);
+    ini__parse_loop(&ini, buf, buflen, &p);
+    ini__arena_close(&arena);
+    ini__number_values(&ini);
+    if (p.hasher) ini.fingerprint = ini__hash_bulk_end(p.hasher, buflen);
+    if (p.error || arena.overflow) {
+        // overflows only happen if the two passes disagree, which they shouldn't
+        ini = CDECL(ini_t){0};
+        ini.error = p.error ? p.error : INI_BUFFER_TOO_SMALL;
+    }
+    return ini;
+}
+
+size_t ini_parse_into_size(const char *buf, size_t buflen, const iniopts_t *options) {
+    ini__parser_t p = {0};
+    p.opts = ini__set_default_opts(options);
+    if (!buf || !ini__arena_check_opts(&p.opts)) return 0;
+    ini__arena_t counter = {0};
+    size_t needed = ini__arena_count(buf, buflen, &p, &counter);
+    return p.error ? 0 : needed;
 }
 
 bool ini_is_valid(ini_t *ctx) {
-    return ctx && ctx->text != NULL;
+    // the text might have been freed if every string was interned, but the
+    // root table is always there
+    return ctx && ctx->tables != NULL;
 }
 
 void ini_free(ini_t *ctx) {
     if (!ctx) return;
-    free(ctx->text);
-    for (initable_t *tab = ctx->tables; tab != ivec_end(ctx->tables); ++tab) {
-        ivec_free(tab->values);
+    if (ctx->fixed) {
+        // everything belongs to the caller
+        *ctx = (ini_t){0};
+        return;
+    }
+    ini__storage_t *storage = ctx->storage;
+    if (storage) {
+        // clones own their list of tables, everything else is shared
+        if (ctx->tables != storage->tables) {
+            ivec_free(ctx->tables);
+        }
+        if (ini__atomic_dec(&storage->refs) == 0) {
+            INI_FREE(storage->text);
+            ini__free_tables(storage->tables, storage->values != NULL);
+            INI_FREE(storage->values);
+            index__free(&storage->index);
+            INI_FREE(storage);
+        }
+    }
+    else {
+        INI_FREE(ctx->text);
+        ini__free_tables(ctx->tables, false);
+        index__free(&ctx->index);
     }
-    ivec_free(ctx->tables);
     *ctx = (ini_t){0};
 }
 
+uint64_t ini_fingerprint(ini_t *ctx) {
+    if (!ctx) return 0;
+    // most documents never need it, so it's only computed while parsing
+    // when asked to (opts.fingerprint)
+    if (!ctx->fingerprint && ctx->text) {
+        ctx->fingerprint = ini__hash_bulk(ctx->text, ctx->textlen, 0);
+    }
+    return ctx->fingerprint;
+}
+
+uint64_t ini_semantic_fingerprint(ini_t *ctx) {
+    if (!ini_is_valid(ctx)) return 0;
+    // tables already have an order independent hash of their content,
+    // so this only needs to mix in their names
+    uint64_t hash = 0;
+    for (initable_t *tab = ctx->tables; tab != ivec_end(ctx->tables); ++tab) {
+        hash += ini__hash_mix(ini__hash(tab->name.buf, tab->name.len, 0) ^ tab->hash);
+    }
+    return ini__hash_mix(hash);
+}
+
+ini_t ini_clone(ini_t *ctx) {
+    ini_t clone = {0};
+    if (!ini_is_valid(ctx) || !ctx->storage) return clone;
+    ini__atomic_inc(&ctx->storage->refs);
+    clone = *ctx;
+    clone.tables = NULL;
+    unsigned int count = ivec_len(ctx->tables);
+    memcpy(ivec_add(clone.tables, count), ctx->tables, sizeof(initable_t) * count);
+    return clone;
+}
+
 initable_t *ini_get_table(ini_t *ctx, const char *name) {
     if (!name) return ctx->tables;
     else       return ini__find_table(ctx, strv__from_str(name));
 }
 
 inivalue_t *ini_get(initable_t *ctx, const char *key) {
-    return ctx ? ini__find_value(ctx, strv__from_str(key)) : NULL;
+    if (!ctx) return NULL;
+    unsigned int pos = ini__find_value_pos(ctx, strv__from_str(key));
+    if (pos == INI__NONE) {
+        INI__PROBE3(get_miss, key, ctx->name.buf, ctx->name.len);
+        return NULL;
+    }
+    INI__PROBE3(get_hit, key, ctx->name.buf, ctx->name.len);
+    ini__count_access(ctx, pos);
+    return ctx->values + pos;
 }   
 
+iniiter_t ini_get_all(initable_t *ctx, const char *key) {
+    iniiter_t it = { ctx, strv__from_str(key), INI__NONE, INI__NONE };
+    if (ctx) {
+        it.first = it.cur = ini__find_value_pos(ctx, it.key);
+    }
+    return it;
+}
+
+initableiter_t ini_table_iter(ini_t *ctx, const char *name) {
+    initableiter_t it = { ctx, INI__NONE, INI__NONE };
+    inistrv_t name_strv = strv__from_str(name);
+    if (ctx && !strv__is_empty(name_strv)) {
+        it.first = it.cur = index__find(
+            &ctx->index, ctx->tables, sizeof(initable_t), ivec_len(ctx->tables), name_strv
+        );
+    }
+    return it;
+}
+
+initable_t *ini_table_next(initableiter_t *it) {
+    if (!it || it->cur == INI__NONE) return NULL;
+    ini_t *ini = it->ini;
+    unsigned int pos = it->cur;
+    unsigned int next = index__next(
+        &ini->index, ini->tables, sizeof(initable_t), ivec_len(ini->tables), pos
+    );
+    it->cur = next == it->first ? INI__NONE : next;
+    return ini->tables + pos;
+}
+
+inivalue_t *ini_iter_next(iniiter_t *it) {
+    if (!it || it->cur == INI__NONE) return NULL;
+    initable_t *table = it->table;
+    unsigned int pos = it->cur;
+    unsigned int next = index__next(
+        &table->index, table->values, sizeof(inivalue_t), ivec_len(table->values), pos
+    );
+    it->cur = next == it->first ? INI__NONE : next;
+    ini__count_access(table, pos);
+    return table->values + pos;
+}
+
 inivec_t(inistrv_t) ini_as_array(const inivalue_t *value, char delim) {
     if (!value) return NULL;
     if (strv__is_empty(value->value)) return 0;
@@ -312,7 +1246,8 @@ inivec_t(inistrv_t) ini_as_array(const inivalue_t *value, char delim) {
 
 unsigned long long ini_as_uint(const inivalue_t *value) {
     if (!value || strv__is_empty(value->value)) return 0;
-    unsigned long long out = strtoull(value->value.buf, NULL, 0);
+    char buf[INI__NUM_MAX];
+    unsigned long long out = strtoull(ini__num_str(value->value, buf, sizeof(buf)), NULL, 0);
     if (out == ULLONG_MAX) {
         out = 0;
     }
@@ -321,7 +1256,8 @@ unsigned long long ini_as_uint(const inivalue_t *value) {
 
 long long ini_as_int(const inivalue_t *value) {
     if (!value || strv__is_empty(value->value)) return 0;
-    long long out = strtoll(value->value.buf, NULL, 0);
+    char buf[INI__NUM_MAX];
+    long long out = strtoll(ini__num_str(value->value, buf, sizeof(buf)), NULL, 0);
     if (out == LONG_MAX || out == LONG_MIN) {
         out = 0;
     }
@@ -330,7 +1266,8 @@ long long ini_as_int(const inivalue_t *value) {
 
 double ini_as_num(const inivalue_t *value) {
     if (!value || strv__is_empty(value->value)) return 0;
-    double out = strtod(value->value.buf, NULL);
+    char buf[INI__NUM_MAX];
+    double out = strtod(ini__num_str(value->value, buf, sizeof(buf)), NULL);
     if (out == HUGE_VAL || out == -HUGE_VAL) {
         out = 0;
     }
@@ -405,163 +1342,1682 @@ inierr_t ini_to_str(const inivalue_t *value, char *buf, size_t buflen, bool remo
     }
 }
 
-const char *ini_explain(inierr_t error) {
-    switch (error) {
-        case INI_NO_ERR:           return "no error";
-        case INI_INVALID_ARGS:     return "invalid arguments";
-        case INI_BUFFER_TOO_SMALL: return "buffer too small";
+inierr_t ini_optimize_layout(ini_t *ctx, ini_t *profile) {
+    if (!ctx || !ctx->tables || ctx->fixed) return INI_INVALID_ARGS;
+    // clones are read only and the original can't move what they are looking at
+    if (ctx->storage && (
+        ctx->tables != ctx->storage->tables || 
+        ini__atomic_load(&ctx->storage->refs) > 1
+    )) {
+        return INI_INVALID_ARGS;
     }
-    return "unknown";
+#ifndef INI_ACCESS_STATS
+    if (!profile) return INI_INVALID_ARGS;
+#endif
+    // the weights are looked up for every key, so this needs the indexes anyway
+    index__push(&ctx->index, ctx->tables, sizeof(initable_t), ivec_len(ctx->tables));
+    for (initable_t *tab = ctx->tables; tab != ivec_end(ctx->tables); ++tab) {
+        index__push(&tab->index, tab->values, sizeof(inivalue_t), ivec_len(tab->values));
+        if (tab->index.slots && tab->short_keys) {
+            ivec_free(tab->short_keys);
+            tab->short_keys = NULL;
+        }
+    }
+    for (initable_t *tab = ctx->tables; tab != ivec_end(ctx->tables); ++tab) {
+        ini__sort_values(ctx, tab, profile);
+    }
+    ini__sort_tables(ctx, profile);
+    ini__number_values(ctx);
+    if (ctx->storage) {
+        ctx->storage->index = ctx->index;
+    }
+    return INI_NO_ERR;
 }
 
-static ini_t ini__parse_internal(char *text, size_t textlen, const iniopts_t *options) {
-    ini_t ini = { text, NULL };
-    if (!text) return ini;
-    iniopts_t opts = ini__set_default_opts(options);
-    // add root table
-    initable_t root = { CDECL(inistrv_t){ "root", 4 }, NULL };
-    ivec_push(ini.tables, root);
-    ini__istream_t in = istr__init(text, textlen);
-    while (!istr__is_finished(&in)) {
-        switch (*in.cur) {
-            case '[':
-                ini__add_table(&ini, &in, &opts);
-                break;
-            case '#': case ';':
-                istr__ignore(&in, '\n');
-                break;
-            default:
-                ini__add_value(ini.tables, &in, &opts);
-                break;
+#ifdef INI_ACCESS_STATS
+inierr_t ini_write_profile(ini_t *ctx, FILE *fp) {
+    if (!ctx || !fp) return INI_INVALID_ARGS;
+    for (initable_t *tab = ctx->tables; tab != ivec_end(ctx->tables); ++tab) {
+        if (tab != ctx->tables) {
+            fprintf(fp, "\n[%.*s]\n", (int)tab->name.len, tab->name.buf);
+        }
+        for (unsigned int i = 0; i < ivec_len(tab->values); ++i) {
+            const inistrv_t key = tab->values[i].key;
+            unsigned int count = i < ivec_len(tab->hits) ? tab->hits[i] : 0;
+            fprintf(fp, "%.*s = %u\n", (int)key.len, key.buf, count);
         }
-        istr__skip_whitespace(&in);
     }
-    return ini;
+    return ferror(fp) ? INI_IO_ERR : INI_NO_ERR;
 }
 
-static char *ini__read_whole_file(FILE *fp, size_t *filelen) {
-    if (!fp) return NULL;
-    fseek(fp, 0, SEEK_END);
-    size_t len = (size_t)ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    char *buf = (char *)malloc(len + 1);
-    size_t read = fread(buf, 1, len, fp);
-    if (read != len) {
-        free(buf);
-        fclose(fp);
-        return NULL;
+void ini_access_report(ini_t *ctx, iniaccess_fn fn, void *userdata) {
+    if (!ctx || !fn) return;
+    for (initable_t *tab = ctx->tables; tab != ivec_end(ctx->tables); ++tab) {
+        for (unsigned int i = 0; i < ivec_len(tab->values); ++i) {
+            unsigned int count = i < ivec_len(tab->hits) ? tab->hits[i] : 0;
+            fn(tab, tab->values + i, count, userdata);
+        }
     }
-    buf[len] = '\0';
-    if (filelen) *filelen = len;
-    return buf;
 }
+#endif
 
-static iniopts_t ini__set_default_opts(const iniopts_t *options) {
-    if (!options) return ini__default_opts;
-
-    iniopts_t opts = ini__default_opts;
-
-    if (options->override_duplicate_keys)
-        opts.override_duplicate_keys = options->override_duplicate_keys;
+static void ini__query_value(unsigned int pos, void *udata) {
+    ini__query_t *q = (ini__query_t *)udata;
+    ini__count_access(q->table, pos);
+    q->matches++;
+    if (q->fn) q->fn(q->table, q->table->values + pos, q->userdata);
+}
 
-    if (options->merge_duplicate_tables)
-        opts.merge_duplicate_tables = options->merge_duplicate_tables;
+static void ini__query_table(unsigned int pos, void *udata) {
+    ini__query_t *q = (ini__query_t *)udata;
+    initable_t *tab = q->ini->tables + pos;
+    q->table = tab;
+    index__match(&tab->index, tab->values, sizeof(inivalue_t), ivec_len(tab->values), q->key_glob, ini__query_value, q);
+}
 
-    if (options->key_value_divider)
-        opts.key_value_divider = options->key_value_divider;
+unsigned int ini_query(ini_t *ctx, const char *table_glob, const char *key_glob, iniquery_fn fn, void *userdata) {
+    if (!ini_is_valid(ctx) || !key_glob) return 0;
+    ini__query_t q = { ctx, NULL, strv__from_str(key_glob), fn, userdata, 0 };
+    if (table_glob == INI_ROOT) {
+        ini__query_table(0, &q);
+    }
+    else {
+        unsigned int count = ivec_len(ctx->tables);
+        index__match(&ctx->index, ctx->tables, sizeof(initable_t), count, strv__from_str(table_glob), ini__query_table, &q);
+    }
+    return q.matches;
+}
 
-    return opts;
+int ini_slots_add(inislots_t *slots, const char *table, const char *key) {
+    if (!slots || !key) return INI_INVALID_ARGS;
+    inikeysel_t sel = { table, key };
+    inislot_t slot = {0};
+    ivec_push(slots->keys, sel);
+    ivec_push(slots->slots, slot);
+    return (int)ivec_len(slots->slots) - 1;
 }
 
-static initable_t *ini__find_table(ini_t *ctx, inistrv_t name) {
-    if (strv__is_empty(name)) return NULL;
-    for (unsigned int i = 0; i < ivec_len(ctx->tables); ++i) {
-        if (strv__cmp(ctx->tables[i].name, name) == 0) {
-            return ctx->tables + i;
+unsigned int ini_slots_bind(inislots_t *slots, ini_t *ctx) {
+    if (!slots) return 0;
+    unsigned int changed = 0;
+    for (unsigned int i = 0; i < ivec_len(slots->slots); ++i) {
+        inislot_t *slot = slots->slots + i;
+        const inikeysel_t *sel = slots->keys + i;
+
+        // don't use ini_get as this shouldn't count as an access
+        initable_t *tab = NULL;
+        if (ini_is_valid(ctx)) {
+            tab = sel->table ? ini__find_table(ctx, strv__from_str(sel->table)) : ctx->tables;
+        }
+        inivalue_t *value = tab ? ini__find_value(tab, strv__from_str(sel->key)) : NULL;
+        // the hash of a missing value is 0, so that a key appearing or
+        // disappearing also counts as a change
+        uint64_t hash = 0;
+        if (value) {
+            inistrv_t val = strv__trim(value->value);
+            hash = ini__hash(val.buf, val.len, 0) | 1;
+        }
+
+        slot->changed = hash != slot->hash;
+        if (slot->changed) {
+            slot->generation++;
+            changed++;
         }
+        slot->value = value;
+        slot->hash = hash;
+        slot->as_int = ini_as_int(value);
+        slot->as_num = ini_as_num(value);
+        slot->as_bool = ini_as_bool(value);
     }
-    return NULL;
+    return changed;
 }
 
-static inivalue_t *ini__find_value(initable_t *table, inistrv_t key) {
-    if (strv__is_empty(key)) return NULL;
-    for (unsigned int i = 0; i < ivec_len(table->values); ++i) {
-        if (strv__cmp(table->values[i].key, key) == 0) {
-            return table->values + i;
+void ini_slots_free(inislots_t *slots) {
+    if (!slots) return;
+    ivec_free(slots->keys);
+    ivec_free(slots->slots);
+    *slots = CDECL(inislots_t){0};
+}
+
+inierr_t ini_subscribe(inisubs_t *subs, const char *table, const char *key, inisub_fn fn, void *userdata) {
+    if (!subs || !fn) return INI_INVALID_ARGS;
+    inisub_t sub = { strv__from_str(table), strv__from_str(key), 0, fn, userdata };
+    sub.hash = ini__hash(sub.key.buf, sub.key.len, ini__hash(sub.table.buf, sub.table.len, 0));
+    ivec_push(subs->subs, sub);
+
+    // subscribers are usually all added at startup, rebuilding the whole
+    // map every time it fills up keeps it simple
+    unsigned int count = ivec_len(subs->subs);
+    if (count * 2 > ivec_len(subs->slots)) {
+        unsigned int cap = 16;
+        while (cap < count * 2) cap *= 2;
+        ivec_free(subs->slots);
+        subs->slots = NULL;
+        memset(ivec_add(subs->slots, cap), 0, sizeof(unsigned int) * cap);
+        for (unsigned int i = 0; i < count; ++i) {
+            keyset__insert(subs->slots, subs->subs[i].hash, i);
         }
     }
-    return NULL;
+    else {
+        keyset__insert(subs->slots, sub.hash, count - 1);
+    }
+    return INI_NO_ERR;
 }
 
-static void ini__add_table(ini_t *ctx, ini__istream_t *in, const iniopts_t *options) {
-    istr__skip(in); // skip [
-    inistrv_t name = istr__get_view(in, ']');
-    istr__skip(in); // skip ]
+unsigned int ini_notify(inisubs_t *subs, ini_t *old_ctx, ini_t *new_ctx) {
+    if (!subs || !subs->subs) return 0;
+    ini_t empty = {0};
+    if (!ini_is_valid(old_ctx)) old_ctx = &empty;
+    if (!ini_is_valid(new_ctx)) new_ctx = &empty;
+    subs->calls = 0;
+
+    unsigned int old_count = ivec_len(old_ctx->tables);
+    unsigned int new_count = ivec_len(new_ctx->tables);
+
+    // go through each group of tables with the same name only once, starting
+    // from its first table, and only look inside of it if its hash changed
+    for (unsigned int t = 0; t < new_count; ++t) {
+        inistrv_t name = new_ctx->tables[t].name;
+        if (t > 0 && ini__group_first(new_ctx, name) != t) {
+            continue;
+        }
+        unsigned int old_first = INI__NONE;
+        if (t == 0)             old_first = old_count ? 0 : INI__NONE;
+        else if (old_count > 1) old_first = ini__group_first(old_ctx, name);
 
-    if (strv__is_empty(name)) return;
+        if (old_first != INI__NONE && ini__group_hash(old_ctx, old_first) == ini__group_hash(new_ctx, t)) {
+            continue;
+        }
+        ini__diff_group(subs, old_ctx, old_first, new_ctx, t);
+    }
 
-    initable_t *table = options->merge_duplicate_tables ? ini__find_table(ctx, name) : NULL;
-    if (!table) {
-        ivec_push(ctx->tables, CDECL(initable_t){ name, NULL });
-        table = &ivec_back(ctx->tables);
+    // tables that are gone, the root table only if the whole document is
+    if (old_count && !new_count) {
+        ini__diff_group(subs, old_ctx, 0, new_ctx, INI__NONE);
     }
-    istr__ignore(in, '\n');
-    istr__skip(in);
-    while (!istr__is_finished(in)) {
-        switch (*in->cur) {
-            case '\n': case '\r':
-                return;
-            case '#': case ';':
-                istr__ignore(in, '\n');
-                break;
-            default:
-                ini__add_value(table, in, options);
-                break;
+    for (unsigned int t = 1; t < old_count; ++t) {
+        inistrv_t name = old_ctx->tables[t].name;
+        if (ini__group_first(old_ctx, name) != t) {
+            continue;
+        }
+        if (!new_count || ini__group_first(new_ctx, name) == INI__NONE) {
+            ini__diff_group(subs, old_ctx, t, new_ctx, INI__NONE);
         }
     }
+
+    return subs->calls;
 }
 
-static void ini__add_value(initable_t *table, ini__istream_t *in, const iniopts_t *options) {
-    if (!table) return;
+void ini_subs_free(inisubs_t *subs) {
+    if (!subs) return;
+    ivec_free(subs->subs);
+    ivec_free(subs->slots);
+    *subs = CDECL(inisubs_t){0};
+}
 
-    inistrv_t key = strv__trim(istr__get_view(in, options->key_value_divider));
-    istr__skip(in); // skip divider
-    inistrv_t val = strv__trim(istr__get_view(in, '\n'));
+const char *ini_intern(inipool_t *pool, const char *str) {
+    if (!pool || !str) return NULL;
+    return ini__intern(pool, strv__from_str(str)).buf;
+}
 
-    if (strv__is_empty(key)) return;
+void ini_cache_free(inicache_t *cache) {
+    if (!cache) return;
+    for (inicacheentry_t *e = cache->entries; e != ivec_end(cache->entries); ++e) {
+        ini_free(&e->doc);
+    }
+    ivec_free(cache->entries);
+    *cache = (inicache_t){0};
+}
 
-    // find inline comments
-    for (size_t i = 0; i < val.len; ++i) {
-        if (val.buf[i] == '#' || val.buf[i] == ';') {
-            // can escape # and ; with a backslash (e.g. \#)
-            if (i > 0 && val.buf[i-1] == '\\') {
-                continue;
-            }
-            val.len = i;
-            break;
-        }
+void ini_pool_free(inipool_t *pool) {
+    if (!pool) return;
+    for (char **block = pool->blocks; block != ivec_end(pool->blocks); ++block) {
+        INI_FREE(*block);
     }
+    ivec_free(pool->blocks);
+    ivec_free(pool->strings);
+    index__free(&pool->index);
+    *pool = CDECL(inipool_t){0};
+}
 
-    // value might be until EOF, in that case no use in skipping
-    if (!istr__is_finished(in)) istr__skip(in); // skip \n
-    inivalue_t *new_val = options->override_duplicate_keys ? ini__find_value(table, key) : NULL;
+inierr_t ini_bundle_write(const char *filename, const char **names, ini_t *docs, unsigned int count) {
+    if (!filename || (count && (!names || !docs))) return INI_INVALID_ARGS;
+
+    ini__bundle_writer_t w = {0};
+    inivec_t(char) docs_buf = NULL;
+    inivec_t(ini__bundle_dir_t) dir = NULL;
+
+    uint32_t dir_cap = 16;
+    while (dir_cap < count * 2) dir_cap *= 2;
+    memset(ivec_add(dir, dir_cap), 0, sizeof(ini__bundle_dir_t) * dir_cap);
+    uint64_t docs_off = sizeof(ini__bundle_header_t) + sizeof(ini__bundle_dir_t) * dir_cap;
+
+    for (unsigned int d = 0; d < count; ++d) {
+        ini_t *doc = docs + d;
+        inistrv_t name = strv__from_str(names[d]);
+        if (strv__is_empty(name) || !ini_is_valid(doc)) continue;
+
+        ini__bundle_doc_t header = { ivec_len(doc->tables), 0 };
+        for (initable_t *tab = doc->tables; tab != ivec_end(doc->tables); ++tab) {
+            header.value_count += ivec_len(tab->values);
+        }
+
+        size_t size = sizeof(ini__bundle_doc_t) + 
+                      sizeof(ini__bundle_table_t) * header.table_count +
+                      sizeof(ini__bundle_value_t) * header.value_count;
+        uint64_t off = docs_off + ivec_len(docs_buf);
+        char *rec = ivec_add(docs_buf, size);
+        memcpy(rec, &header, sizeof(header));
+        ini__bundle_table_t *tables = (ini__bundle_table_t *)(rec + sizeof(header));
+        ini__bundle_value_t *values = (ini__bundle_value_t *)(tables + header.table_count);
+
+        uint32_t first = 0;
+        for (unsigned int t = 0; t < header.table_count; ++t) {
+            initable_t *tab = doc->tables + t;
+            ini__bundle_table_t btab = { 
+                ini__bundle_add_str(&w, tab->name), (uint32_t)tab->name.len, 
+                first, ivec_len(tab->values) 
+            };
+            for (unsigned int v = 0; v < ivec_len(tab->values); ++v) {
+                inivalue_t *val = tab->values + v;
+                ini__bundle_value_t bval = {
+                    ini__bundle_add_str(&w, val->key), (uint32_t)val->key.len,
+                    ini__bundle_add_str(&w, val->value), (uint32_t)val->value.len,
+                };
+                values[first + v] = bval;
+            }
+            tables[t] = btab;
+            first += btab.count;
+        }
+
+        ini__bundle_dir_t entry = { ini__hash(name.buf, name.len, 0), off, ini__bundle_add_str(&w, name), (uint32_t)name.len };
+        uint32_t slot = (uint32_t)entry.hash & (dir_cap - 1);
+        while (dir[slot].doc_off) slot = (slot + 1) & (dir_cap - 1);
+        dir[slot] = entry;
+    }
+
+    ini__bundle_header_t header = {0};
+    memcpy(header.magic, ini__bundle_magic, sizeof(header.magic));
+    header.doc_count = count;
+    header.dir_cap = dir_cap;
+    header.dir_off = sizeof(ini__bundle_header_t);
+    header.strings_off = docs_off + ivec_len(docs_buf);
+    header.strings_len = ivec_len(w.strings);
+
+    inierr_t err = INI_NO_ERR;
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) {
+        err = INI_IO_ERR;
+    }
+    else {
+        fwrite(&header, sizeof(header), 1, fp);
+        fwrite(dir, sizeof(ini__bundle_dir_t), dir_cap, fp);
+        if (docs_buf) fwrite(docs_buf, 1, ivec_len(docs_buf), fp);
+        if (w.strings) fwrite(w.strings, 1, ivec_len(w.strings), fp);
+        // padding after the strings, so that they can be read past their end when mapped
+        static const char padding[INI_PADDING] = {0};
+        fwrite(padding, 1, sizeof(padding), fp);
+        if (ferror(fp)) err = INI_IO_ERR;
+        if (fclose(fp)) err = INI_IO_ERR;
+    }
+
+    ivec_free(w.strings);
+    ivec_free(w.offsets);
+    index__free(&w.index);
+    ivec_free(docs_buf);
+    ivec_free(dir);
+    return err;
+}
+
+inibundle_t ini_bundle_open(const char *filename) {
+    inibundle_t bundle = { NULL, 0, false };
+    if (!filename) return bundle;
+
+#ifdef INI__POSIX
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return bundle;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            bundle.data = (const char *)data;
+            bundle.size = (size_t)st.st_size;
+            bundle.mapped = true;
+        }
+    }
+    close(fd);
+#else
+    FILE *fp = fopen(filename, "rb");
+    inierr_t error = INI_NO_ERR;
+    bundle.data = ini__read_whole_file(fp, &bundle.size, 0, &error);
+    if (fp) fclose(fp);
+#endif
+
+    // make sure that the header and the directory are actually there
+    const ini__bundle_header_t *header = (const ini__bundle_header_t *)bundle.data;
+    if (bundle.data && (
+        bundle.size < sizeof(ini__bundle_header_t) ||
+        memcmp(header->magic, ini__bundle_magic, sizeof(header->magic)) != 0 ||
+        header->dir_cap == 0 || (header->dir_cap & (header->dir_cap - 1)) != 0 ||
+        header->dir_off % 8 != 0 || header->dir_off > bundle.size ||
+        (uint64_t)header->dir_cap * sizeof(ini__bundle_dir_t) > bundle.size - header->dir_off ||
+        header->strings_off > bundle.size || header->strings_len > bundle.size - header->strings_off
+    )) {
+        ini_bundle_close(&bundle);
+    }
+    return bundle;
+}
+
+bool ini_bundle_is_valid(inibundle_t *bundle) {
+    return bundle && bundle->data != NULL;
+}
+
+ini_t ini_bundle_get(inibundle_t *bundle, const char *name) {
+    ini_t ini = {0};
+    if (!ini_bundle_is_valid(bundle) || !name) return ini;
+
+    const ini__bundle_header_t *header = (const ini__bundle_header_t *)bundle->data;
+    const ini__bundle_dir_t *dir = (const ini__bundle_dir_t *)(bundle->data + header->dir_off);
+    inistrv_t name_strv = strv__from_str(name);
+    uint64_t hash = ini__hash(name_strv.buf, name_strv.len, 0);
+
+    // a corrupt directory might not have any empty slot, so stop after a full lap
+    uint64_t doc_off = 0;
+    uint32_t mask = header->dir_cap - 1;
+    uint32_t i = (uint32_t)hash & mask;
+    for (uint32_t step = 0; step < header->dir_cap && dir[i].doc_off; ++step, i = (i + 1) & mask) {
+        if (dir[i].hash == hash && 
+            strv__cmp(ini__bundle_str(bundle, dir[i].name_off, dir[i].name_len), name_strv) == 0
+        ) {
+            doc_off = dir[i].doc_off;
+            break;
+        }
+    }
+    // documents are 8 byte aligned and live between the directory and the strings
+    uint64_t docs_off = header->dir_off + (uint64_t)header->dir_cap * sizeof(ini__bundle_dir_t);
+    if (!doc_off || doc_off % 8 != 0 || doc_off < docs_off ||
+        doc_off > header->strings_off || header->strings_off - doc_off < sizeof(ini__bundle_doc_t)
+    ) {
+        return ini;
+    }
+
+    const ini__bundle_doc_t *doc = (const ini__bundle_doc_t *)(bundle->data + doc_off);
+    uint64_t doc_end = doc_off + sizeof(ini__bundle_doc_t) + 
+                       (uint64_t)doc->table_count * sizeof(ini__bundle_table_t) +
+                       (uint64_t)doc->value_count * sizeof(ini__bundle_value_t);
+    if (doc->table_count == 0 || doc_end > header->strings_off) return ini;
+
+    const ini__bundle_table_t *tables = (const ini__bundle_table_t *)(doc + 1);
+    const ini__bundle_value_t *values = (const ini__bundle_value_t *)(tables + doc->table_count);
+
+    (void)ivec_reserve(ini.tables, doc->table_count);
+    for (uint32_t t = 0; t < doc->table_count; ++t) {
+        initable_t tab = {0};
+        tab.name = t == 0 ? ini__root_name : ini__bundle_str(bundle, tables[t].name_off, tables[t].name_len);
+        if (tables[t].first > doc->value_count || tables[t].count > doc->value_count - tables[t].first) {
+            break;
+        }
+        if (tables[t].count) (void)ivec_reserve(tab.values, tables[t].count);
+        for (uint32_t v = 0; v < tables[t].count; ++v) {
+            const ini__bundle_value_t *bval = values + tables[t].first + v;
+            inivalue_t val = {
+                ini__bundle_str(bundle, bval->key_off, bval->key_len),
+                ini__bundle_str(bundle, bval->val_off, bval->val_len),
+            };
+            ivec_push(tab.values, val);
+            tab.hash += ini__pair_hash(val.key, val.value);
+            index__push(&tab.index, tab.values, sizeof(inivalue_t), ivec_len(tab.values));
+        }
+        ivec_push(ini.tables, tab);
+        index__push(&ini.index, ini.tables, sizeof(initable_t), ivec_len(ini.tables));
+    }
+
+    ini__finalize(&ini, false, false);
+    return ini;
+}
+
+void ini_bundle_close(inibundle_t *bundle) {
+    if (!bundle || !bundle->data) return;
+#ifdef INI__POSIX
+    if (bundle->mapped) {
+        munmap((void *)bundle->data, bundle->size);
+    }
+    else
+#endif
+    {
+        INI_FREE((void *)bundle->data);
+    }
+    *bundle = CDECL(inibundle_t){ NULL, 0, false };
+}
+
+inidelta_t ini_delta(ini_t *base) {
+    inidelta_t delta;
+    delta.base = base;
+    delta.used = 0;
+    delta.count = 0;
+    return delta;
+}
+
+inierr_t ini_delta_set(inidelta_t *delta, const char *table, const char *key, const char *value) {
+    if (!delta || !key) return INI_INVALID_ARGS;
+    inideltaentry_t *entry = ini__delta_find(delta, strv__from_str(table), strv__from_str(key), true);
+    if (!entry) return INI_BUFFER_TOO_SMALL;
+    entry->value.value = strv__from_str(value);
+    entry->removed = false;
+    return INI_NO_ERR;
+}
+
+inierr_t ini_delta_remove(inidelta_t *delta, const char *table, const char *key) {
+    if (!delta || !key) return INI_INVALID_ARGS;
+    inideltaentry_t *entry = ini__delta_find(delta, strv__from_str(table), strv__from_str(key), true);
+    if (!entry) return INI_BUFFER_TOO_SMALL;
+    entry->removed = true;
+    return INI_NO_ERR;
+}
+
+inivalue_t *ini_delta_get(inidelta_t *delta, const char *table, const char *key) {
+    if (!delta || !key) return NULL;
+    if (delta->count) {
+        inideltaentry_t *entry = ini__delta_find(delta, strv__from_str(table), strv__from_str(key), false);
+        if (entry) return entry->removed ? NULL : &entry->value;
+    }
+    return delta->base ? ini_get(ini_get_table(delta->base, table), key) : NULL;
+}
+
+const char *ini_explain(inierr_t error) {
+    switch (error) {
+        case INI_NO_ERR:           return "no error";
+        case INI_INVALID_ARGS:     return "invalid arguments";
+        case INI_BUFFER_TOO_SMALL: return "buffer too small";
+        case INI_IO_ERR:           return "io error";
+        case INI_LIMIT_BYTES:      return "file too big";
+        case INI_LIMIT_TABLES:     return "too many tables";
+        case INI_LIMIT_KEYS:       return "too many keys";
+        case INI_LIMIT_TABLE_KEYS: return "too many keys in a table";
+        case INI_LIMIT_LINE:       return "line too long";
+        case INI_CANCELLED:        return "parsing cancelled";
+        case INI_OUT_OF_MEMORY:    return "out of memory";
+    }
+    return "unknown";
+}
+
+// if <copy> is true <text> is only copied when it has to be parsed,
+// otherwise it is owned by the document (or freed on a cache hit)
+static ini_t ini__parse_internal(char *text, size_t textlen, bool copy, const iniopts_t *options) {
+    INI__PROBE1(parse_start, textlen);
+    ini_t ini = ini__parse_text(text, textlen, copy, options);
+    INI__PROBE3(parse_done, textlen, ivec_len(ini.tables), ini.error);
+    return ini;
+}
+
+static ini_t ini__parse_text(char *text, size_t textlen, bool copy, const iniopts_t *options) {
+    ini_t ini = {0};
+    if (!text) return ini;
+    ini__parser_t p = {0};
+    p.opts = ini__set_default_opts(options);
+    if (p.opts.max_bytes && textlen > p.opts.max_bytes) {
+        if (!copy) INI_FREE(text);
+        ini.error = INI_LIMIT_BYTES;
+        return ini;
+    }
+    uint64_t fingerprint = 0;
+    uint64_t opts_hash = 0;
+    ini__bulkhash_t hasher;
+    if (p.opts.cache) {
+        fingerprint = ini__hash_bulk(text, textlen, 0);
+        opts_hash = ini__opts_hash(&p.opts);
+        ini = ini__cache_get(p.opts.cache, fingerprint, opts_hash, text, textlen);
+        if (ini_is_valid(&ini)) {
+            if (!copy) INI_FREE(text);
+            return ini;
+        }
+    }
+    bool borrowed = copy && p.opts.borrow_buffer;
+    ini.text = copy && !borrowed ? ini__strdup_padded(text, textlen) : text;
+    if (!ini.text && textlen) {
+        ini.error = INI_OUT_OF_MEMORY;
+        return ini;
+    }
+    text = ini.text;
+    ini.fingerprint = fingerprint;
+    ini.textlen = textlen;
+    keyset__init(&p.keyset, p.opts.only_keys);
+    if (p.opts.fingerprint && !p.opts.cache && text) {
+        ini__hash_bulk_init(&hasher, text, 0);
+        p.hasher = &hasher;
+    }
+    // add root table
+    initable_t root = {0};
+    root.name = ini__root_name;
+    ivec_push(ini.tables, root);
+    ini__parse_loop(&ini, text, textlen, &p);
+    keyset__free(&p.keyset);
+    if (p.hasher) ini.fingerprint = ini__hash_bulk_end(p.hasher, textlen);
+    if (p.error) {
+        ini__free_tables(ini.tables, false);
+        index__free(&ini.index);
+        if (!borrowed) INI_FREE(ini.text);
+        ini = CDECL(ini_t){0};
+        ini.error = p.error;
+        return ini;
+    }
+    if (p.opts.intern_pool && p.opts.intern_values) {
+        // nothing points into the text anymore
+        if (!borrowed) INI_FREE(ini.text);
+        ini.text = NULL;
+    }
+    ini__finalize(&ini, p.opts.sorted_index, p.opts.contiguous_values);
+    if (borrowed) {
+        // the document can still read it, but must not free it
+        if (ini.storage) ini.storage->text = NULL;
+        else             ini.text = NULL;
+        return ini;
+    }
+    if (p.opts.cache) {
+        return ini__cache_put(p.opts.cache, &ini, opts_hash, textlen);
+    }
+    return ini;
+}
+
+static void ini__parse_loop(ini_t *ini, const char *text, size_t textlen, ini__parser_t *p) {
+    ini__istream_t in = istr__init(text, textlen);
+    while (!istr__is_finished(&in) && !p->error) {
+        const char *line_start = in.cur;
+        switch (*in.cur) {
+            case '[':
+                ini__add_table(ini, &in, p);
+                break;
+            case '#': case ';':
+                istr__ignore(&in, '\n');
+                ini__check_line(p, &in, line_start);
+                break;
+            default:
+                ini__add_value(ini->tables, &in, p);
+                break;
+        }
+        istr__skip_whitespace(&in);
+    }
+}
+
+static void ini__check_line(ini__parser_t *p, ini__istream_t *in, const char *line_start) {
+    if (p->opts.max_line_length) {
+        size_t len = (size_t)(in->cur - line_start);
+        if (len && in->cur[-1] == '\n') len--;
+        if (len > p->opts.max_line_length) p->error = INI_LIMIT_LINE;
+    }
+    ini__check_cancel(p, in);
+}
+
+static void ini__check_cancel(ini__parser_t *p, ini__istream_t *in) {
+    // called after every line, which is still in cache
+    if (p->hasher) ini__hash_bulk_feed(p->hasher, in->cur);
+    if (!p->opts.cancel) return;
+    size_t pos = (size_t)(in->cur - in->start);
+    if (pos < p->next_check) return;
+    p->next_check = pos + INI_CANCEL_INTERVAL;
+    if (p->opts.cancel(p->opts.userdata)) p->error = INI_CANCELLED;
+}
+
+static bool ini__arena_check_opts(const iniopts_t *opts) {
+    // merging tables would also break the layout, as the values of a table
+    // wouldn't be contiguous anymore
+    return !opts->merge_duplicate_tables && !opts->only_keys && 
+           !opts->intern_pool && !opts->cache && !opts->sorted_index &&
+           !opts->inline_keys && !opts->lookup_index;
+}
+
+static size_t ini__arena_count(const char *buf, size_t buflen, ini__parser_t *p, ini__arena_t *counter) {
+    // <counter> belongs to the caller, which needs the counts to lay out the arena
+    if (p->opts.max_bytes && buflen > p->opts.max_bytes) {
+        p->error = INI_LIMIT_BYTES;
+        return 0;
+    }
+    p->arena = counter;
+    ini_t ini = {0};
+    counter->scratch[0].name = ini__root_name;
+    ini.tables = counter->scratch;
+    ini__parse_loop(&ini, buf, buflen, p);
+    p->arena = NULL;
+    // values are counted before override_duplicate_keys drops any, so this is an upper bound.
+    // every vector has an 8 byte header and one more item than it needs, plus 8 bytes to align <mem>
+    size_t header = sizeof(unsigned int) * 2;
+    return 8 +
+        header + sizeof(initable_t) * (counter->tables + 2) +
+        header + sizeof(inivalue_t) * (counter->root_values + 1) +
+        (header + sizeof(inivalue_t)) * counter->tables + sizeof(inivalue_t) * counter->values;
+}
+
+static void *ini__arena_vec(ini__arena_t *arena, unsigned int cap, size_t itemsize) {
+    size_t header = sizeof(unsigned int) * 2;
+    if (arena->cap - arena->used < header + itemsize * cap) {
+        arena->overflow = true;
+        return NULL;
+    }
+    unsigned int *vec = (unsigned int *)(arena->mem + arena->used);
+    vec[0] = cap;
+    vec[1] = 0;
+    arena->used += header + itemsize * cap;
+    return vec + 2;
+}
+
+static void ini__arena_close(ini__arena_t *arena) {
+    // give back the memory that the last table didn't use
+    initable_t *tab = arena->open;
+    if (!tab || !tab->values) return;
+    unsigned int cap = ivec_cap(tab->values);
+    unsigned int len = ivec_len(tab->values);
+    arena->used -= sizeof(inivalue_t) * (cap - len - 1);
+    ini__vec_cap(tab->values) = len + 1;
+    arena->open = NULL;
+}
+
+static initable_t *ini__push_table(ini_t *ctx, initable_t table, ini__parser_t *p) {
+    ini__arena_t *arena = p->arena;
+    if (!arena) {
+        INI__PROBE2(table_new, table.name.buf, table.name.len);
+        ivec_push(ctx->tables, table);
+        if (p->opts.lookup_index || p->opts.merge_duplicate_tables) {
+            index__push(&ctx->index, ctx->tables, sizeof(initable_t), ivec_len(ctx->tables));
+        }
+        return &ivec_back(ctx->tables);
+    }
+    if (!arena->mem) {
+        arena->tables++;
+        arena->scratch[1] = table;
+        return &arena->scratch[1];
+    }
+    ini__arena_close(arena);
+    if (ini__vec_need_grow(ctx->tables, 1)) {
+        // the values still need to be skipped, they just go nowhere
+        arena->overflow = true;
+        arena->scratch[1] = table;
+        return &arena->scratch[1];
+    }
+    INI__PROBE2(table_new, table.name.buf, table.name.len);
+    ivec_push(ctx->tables, table);
+    initable_t *tab = &ivec_back(ctx->tables);
+    size_t header = sizeof(unsigned int) * 2;
+    size_t left = arena->cap - arena->used;
+    unsigned int cap = left > header ? (unsigned int)((left - header) / sizeof(inivalue_t)) : 0;
+    tab->values = cap ? (inivalue_t *)ini__arena_vec(arena, cap, sizeof(inivalue_t)) : NULL;
+    arena->open = tab;
+    return tab;
+}
+
+static void ini__push_value(initable_t *table, inivalue_t value, ini__parser_t *p) {
+    ini__arena_t *arena = p->arena;
+    if (!arena) {
+        ivec_push(table->values, value);
+        if (p->opts.lookup_index || p->opts.override_duplicate_keys) {
+            index__push(&table->index, table->values, sizeof(inivalue_t), ivec_len(table->values));
+        }
+        if (p->opts.inline_keys && !table->index.slots) {
+            ivec_push(table->short_keys, ini__short_key(value.key));
+        }
+        else if (table->short_keys) {
+            // the table just got an index, the copies would never be read again
+            ivec_free(table->short_keys);
+            table->short_keys = NULL;
+        }
+        return;
+    }
+    if (!arena->mem) {
+        if (table->name.buf == ini__root_name.buf) arena->root_values++;
+        else                                       arena->values++;
+        return;
+    }
+    if (ini__vec_need_grow(table->values, 1)) {
+        arena->overflow = true;
+        return;
+    }
+    ivec_push(table->values, value);
+}
+
+static void ini__finalize(ini_t *ini, bool sorted_index, bool contiguous) {
+    if (sorted_index) {
+        for (initable_t *tab = ini->tables; tab != ivec_end(ini->tables); ++tab) {
+            index__sort(&tab->index, tab->values, sizeof(inivalue_t), ivec_len(tab->values));
+        }
+        index__sort(&ini->index, ini->tables, sizeof(initable_t), ivec_len(ini->tables));
+    }
+#ifdef INI_ACCESS_STATS
+    // the counters are allocated once at the end, so the increments never
+    // have to deal with the vector moving
+    for (initable_t *tab = ini->tables; tab != ivec_end(ini->tables); ++tab) {
+        unsigned int count = ivec_len(tab->values);
+        if (count) memset(ivec_add(tab->hits, count), 0, sizeof(unsigned int) * count);
+    }
+#endif
+    ini->storage = (ini__storage_t *)INI_MALLOC(sizeof(ini__storage_t));
+    if (ini->storage) {
+        ini->storage->refs = 1;
+        ini->storage->text = ini->text;
+        ini->storage->tables = ini->tables;
+        ini->storage->index = ini->index;
+        ini->storage->values = NULL;
+        if (contiguous) ini__pack_values(ini);
+    }
+    ini__number_values(ini);
+}
+
+static void ini__pack_values(ini_t *ini) {
+    // same layout as ini_parse_into: every vector keeps its header, so the
+    // values are contiguous except for 8 bytes at the start of each table
+    size_t header = sizeof(unsigned int) * 2;
+    size_t size = 0;
+    for (initable_t *tab = ini->tables; tab != ivec_end(ini->tables); ++tab) {
+        if (ivec_len(tab->values)) size += header + sizeof(inivalue_t) * ivec_len(tab->values);
+    }
+    char *block = size ? (char *)INI_MALLOC(size) : NULL;
+    // if it fails every table simply keeps its own vector
+    if (!block) return;
+    char *cur = block;
+    for (initable_t *tab = ini->tables; tab != ivec_end(ini->tables); ++tab) {
+        unsigned int len = ivec_len(tab->values);
+        unsigned int *vec = (unsigned int *)cur;
+        if (len) {
+            vec[0] = vec[1] = len;
+            memcpy(vec + 2, tab->values, sizeof(inivalue_t) * len);
+            cur += header + sizeof(inivalue_t) * len;
+        }
+        ivec_free(tab->values);
+        tab->values = len ? (inivalue_t *)(vec + 2) : NULL;
+    }
+    ini->storage->values = block;
+}
+
+static void ini__number_values(ini_t *ini) {
+    unsigned int count = 0;
+    for (initable_t *tab = ini->tables; tab != ivec_end(ini->tables); ++tab) {
+        tab->first = count;
+        count += ivec_len(tab->values);
+    }
+    ini->value_count = count;
+}
+
+static uint64_t ini__opts_hash(const iniopts_t *opts) {
+    // pointers are hashed by address, the same list in two different places
+    // is simply a miss
+    uint64_t fields[12] = {0};
+    fields[0] = opts->merge_duplicate_tables | (opts->override_duplicate_keys << 1) |
+                (opts->intern_values << 2) | (opts->sorted_index << 3) |
+                (opts->inline_keys << 4) | (opts->contiguous_values << 5) |
+                (opts->lookup_index << 6);
+    fields[1] = (unsigned char)opts->key_value_divider;
+    memcpy(&fields[2], &opts->only_tables, sizeof(opts->only_tables));
+    memcpy(&fields[3], &opts->table_filter, sizeof(opts->table_filter));
+    memcpy(&fields[4], &opts->userdata, sizeof(opts->userdata));
+    memcpy(&fields[5], &opts->only_keys, sizeof(opts->only_keys));
+    memcpy(&fields[6], &opts->intern_pool, sizeof(opts->intern_pool));
+    // a document parsed with looser limits can't be given to someone with stricter ones
+    fields[7] = opts->max_bytes;
+    fields[8] = opts->max_tables | ((uint64_t)opts->max_keys << 32);
+    fields[9] = opts->max_table_keys;
+    fields[10] = opts->max_line_length;
+    return ini__hash(fields, sizeof(fields), 0);
+}
+
+// bytes used by <ctx>, what the cache counts against max_bytes: the text it owns,
+// its tables, values and indexes
+static size_t ini__mem_usage(ini_t *ctx) {
+    if (!ini_is_valid(ctx)) return 0;
+    size_t header = sizeof(unsigned int) * 2;
+    bool owns_text = ctx->storage ? ctx->storage->text != NULL : !ctx->fixed;
+    size_t bytes = owns_text && ctx->text ? ctx->textlen + INI_PADDING : 0;
+    if (ctx->storage) bytes += sizeof(ini__storage_t);
+    bytes += header + ivec_cap(ctx->tables) * sizeof(initable_t);
+    bytes += (ivec_cap(ctx->index.slots) + ivec_cap(ctx->index.chain) + ivec_cap(ctx->index.sorted)) * sizeof(unsigned int);
+    for (initable_t *tab = ctx->tables; tab != ivec_end(ctx->tables); ++tab) {
+        if (tab->values) bytes += header + ivec_cap(tab->values) * sizeof(inivalue_t);
+        if (tab->short_keys) bytes += header + ivec_cap(tab->short_keys) * sizeof(inishortkey_t);
+        bytes += (ivec_cap(tab->index.slots) + ivec_cap(tab->index.chain) + ivec_cap(tab->index.sorted)) * sizeof(unsigned int);
+#ifdef INI_ACCESS_STATS
+        bytes += ivec_cap(tab->hits) * sizeof(unsigned int);
+#endif
+    }
+    return bytes;
+}
+
+static ini_t ini__cache_get(inicache_t *cache, uint64_t fingerprint, uint64_t opts_hash, const char *text, size_t textlen) {
+    // caches are meant for a few distinct files, so a linear search over
+    // the fingerprints is enough
+    for (inicacheentry_t *e = cache->entries; e != ivec_end(cache->entries); ++e) {
+        if (e->fingerprint != fingerprint || e->opts_hash != opts_hash || e->textlen != textlen) {
+            continue;
+        }
+        // a matching fingerprint is easy to forge, only the text itself is enough
+        if (!e->doc.text || memcmp(e->doc.text, text, textlen) != 0) {
+            continue;
+        }
+        e->last_use = ++cache->clock;
+        cache->hits++;
+        return ini_clone(&e->doc);
+    }
+    cache->misses++;
+    return CDECL(ini_t){0};
+}
+
+static ini_t ini__cache_put(inicache_t *cache, ini_t *ini, uint64_t opts_hash, size_t textlen) {
+    // without the text (intern_values) a hit couldn't be checked
+    if (!ini->storage || !ini->text) return *ini;
+    size_t bytes = ini__mem_usage(ini);
+    if (cache->max_bytes && bytes > cache->max_bytes) return *ini;
+    // evict the least recently used documents until the new one fits
+    while (ivec_len(cache->entries) && (
+        (cache->max_entries && ivec_len(cache->entries) >= cache->max_entries) ||
+        (cache->max_bytes && cache->bytes + bytes > cache->max_bytes)
+    )) {
+        inicacheentry_t *lru = cache->entries;
+        for (inicacheentry_t *e = cache->entries; e != ivec_end(cache->entries); ++e) {
+            if (e->last_use < lru->last_use) lru = e;
+        }
+        cache->bytes -= lru->bytes;
+        cache->evictions++;
+        ini_free(&lru->doc);
+        ivec_rem_it(cache->entries, lru);
+    }
+    inicacheentry_t entry = {0};
+    entry.fingerprint = ini->fingerprint;
+    entry.opts_hash = opts_hash;
+    entry.textlen = textlen;
+    entry.bytes = bytes;
+    entry.last_use = ++cache->clock;
+    entry.doc = *ini;
+    ivec_push(cache->entries, entry);
+    cache->bytes += bytes;
+    // the cache keeps the original, so every parse returns a read only clone
+    return ini_clone(&ivec_back(cache->entries).doc);
+}
+
+static void ini__free_tables(inivec_t(initable_t) tables, bool packed) {
+    for (initable_t *tab = tables; tab != ivec_end(tables); ++tab) {
+        if (!packed) ivec_free(tab->values);
+        ivec_free(tab->short_keys);
+        index__free(&tab->index);
+#ifdef INI_ACCESS_STATS
+        ivec_free(tab->hits);
+#endif
+    }
+    ivec_free(tables);
+}
+
+// with a <max_bytes> (0 means no limit) bigger files set <error> to INI_LIMIT_BYTES and
+// return NULL: regular files right away, pipes once more than <max_bytes> were read
+static char *ini__read_whole_file(FILE *fp, size_t *filelen, size_t max_bytes, inierr_t *error) {
+    if (!fp) return NULL;
+#ifdef INI__POSIX_IO
+    // stdio would only add a copy
+    return ini__read_fd(fileno(fp), filelen, max_bytes, error);
+#else
+    // regular files tell us their size, pipes don't so the buffer grows instead
+    size_t cap = 4096, len = 0;
+    bool sized = false;
+    long pos = ftell(fp);
+    if (pos >= 0 && fseek(fp, 0, SEEK_END) == 0) {
+        long end = ftell(fp);
+        if (end >= pos && fseek(fp, pos, SEEK_SET) == 0) {
+            if (max_bytes && (size_t)(end - pos) > max_bytes) {
+                *error = INI_LIMIT_BYTES;
+                return NULL;
+            }
+            cap = (size_t)(end - pos) + 1;
+            sized = true;
+        }
+    }
+    // never read more than one byte past the limit
+    if (max_bytes && cap > max_bytes + 2) cap = max_bytes + 2;
+    char *buf = (char *)INI_MALLOC(cap + INI_PADDING);
+    while (buf) {
+        if (len + 1 == cap) {
+            if (sized) break;
+            if (max_bytes && len > max_bytes) {
+                INI_FREE(buf);
+                *error = INI_LIMIT_BYTES;
+                return NULL;
+            }
+            size_t newcap = max_bytes && cap * 2 > max_bytes + 2 ? max_bytes + 2 : cap * 2;
+            char *newbuf = (char *)INI_REALLOC(buf, newcap + INI_PADDING);
+            if (!newbuf) {
+                INI_FREE(buf);
+                return NULL;
+            }
+            buf = newbuf;
+            cap = newcap;
+        }
+        size_t read = fread(buf + len, 1, cap - 1 - len, fp);
+        len += read;
+        if (read == 0) break;
+    }
+    if (!buf || ferror(fp)) {
+        INI_FREE(buf);
+        return NULL;
+    }
+    if (max_bytes && len > max_bytes) {
+        INI_FREE(buf);
+        *error = INI_LIMIT_BYTES;
+        return NULL;
+    }
+    memset(buf + len, 0, INI_PADDING);
+    if (filelen) *filelen = len;
+    INI__PROBE1(file_read, len);
+    return buf;
+#endif
+}
+
+#ifdef INI__POSIX
+// same as ini__read_whole_file
+static char *ini__read_fd(int fd, size_t *filelen, size_t max_bytes, inierr_t *error) {
+    if (fd < 0) return NULL;
+    // regular files are read straight into a buffer of the right size,
+    // pipes don't have a size so the buffer grows instead
+    size_t cap = 4096, len = 0;
+    bool sized = false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        off_t pos = lseek(fd, 0, SEEK_CUR);
+        if (pos >= 0 && st.st_size >= pos) {
+            if (max_bytes && (size_t)(st.st_size - pos) > max_bytes) {
+                *error = INI_LIMIT_BYTES;
+                return NULL;
+            }
+            cap = (size_t)(st.st_size - pos) + 1;
+            sized = true;
+        }
+#if defined(INI__POSIX_IO) && defined(POSIX_FADV_SEQUENTIAL)
+        (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+    // never read more than one byte past the limit
+    if (max_bytes && cap > max_bytes + 2) cap = max_bytes + 2;
+    char *buf = (char *)INI_MALLOC(cap + INI_PADDING);
+    while (buf) {
+        if (len + 1 == cap) {
+            if (sized) break;
+            if (max_bytes && len > max_bytes) {
+                INI_FREE(buf);
+                *error = INI_LIMIT_BYTES;
+                return NULL;
+            }
+            size_t newcap = max_bytes && cap * 2 > max_bytes + 2 ? max_bytes + 2 : cap * 2;
+            char *newbuf = (char *)INI_REALLOC(buf, newcap + INI_PADDING);
+            if (!newbuf) {
+                INI_FREE(buf);
+                return NULL;
+            }
+            buf = newbuf;
+            cap = newcap;
+        }
+        ssize_t read_len = read(fd, buf + len, cap - 1 - len);
+        if (read_len < 0 && errno == EINTR) continue;
+        if (read_len < 0) {
+            INI_FREE(buf);
+            return NULL;
+        }
+        if (read_len == 0) break;
+        len += (size_t)read_len;
+    }
+    if (!buf) return NULL;
+    if (max_bytes && len > max_bytes) {
+        INI_FREE(buf);
+        *error = INI_LIMIT_BYTES;
+        return NULL;
+    }
+    memset(buf + len, 0, INI_PADDING);
+    if (filelen) *filelen = len;
+    INI__PROBE1(file_read, len);
+    return buf;
+}
+#endif
+
+static iniopts_t ini__set_default_opts(const iniopts_t *options) {
+    if (!options) return ini__default_opts;
+
+    iniopts_t opts = ini__default_opts;
+
+    if (options->override_duplicate_keys)
+        opts.override_duplicate_keys = options->override_duplicate_keys;
+
+    if (options->merge_duplicate_tables)
+        opts.merge_duplicate_tables = options->merge_duplicate_tables;
+
+    if (options->key_value_divider)
+        opts.key_value_divider = options->key_value_divider;
+
+    opts.only_tables  = options->only_tables;
+    opts.table_filter = options->table_filter;
+    opts.userdata     = options->userdata;
+    opts.only_keys    = options->only_keys;
+    opts.intern_pool  = options->intern_pool;
+    opts.intern_values = options->intern_values;
+    opts.sorted_index  = options->sorted_index;
+    opts.lookup_index  = options->lookup_index;
+    opts.cache         = options->cache;
+    opts.borrow_buffer = options->borrow_buffer;
+    opts.inline_keys   = options->inline_keys;
+    opts.contiguous_values = options->contiguous_values;
+    opts.fingerprint     = options->fingerprint;
+    opts.max_bytes       = options->max_bytes;
+    opts.max_tables      = options->max_tables;
+    opts.max_keys        = options->max_keys;
+    opts.max_table_keys  = options->max_table_keys;
+    opts.max_line_length = options->max_line_length;
+    opts.cancel          = options->cancel;
+
+    return opts;
+}
+
+static initable_t *ini__find_table(ini_t *ctx, inistrv_t name) {
+    if (strv__is_empty(name)) return NULL;
+    unsigned int pos = index__find(
+        &ctx->index, ctx->tables, sizeof(initable_t), ivec_len(ctx->tables), name
+    );
+    return pos != INI__NONE ? ctx->tables + pos : NULL;
+}
+
+static bool ini__is_table_selected(inistrv_t name, ini__parser_t *p) {
+    const iniopts_t *options = &p->opts;
+
+    // tables without any selected key don't need to be parsed at all
+    if (p->keyset.tables) {
+        inivec_t(unsigned int) slots = p->keyset.tables;
+        unsigned int mask = ivec_len(slots) - 1;
+        unsigned int i = (unsigned int)ini__hash(name.buf, name.len, 0) & mask;
+        bool found = false;
+        for (; slots[i]; i = (i + 1) & mask) {
+            const char *sel = options->only_keys[slots[i] - 1].table;
+            if (strv__cmp(name, strv__from_str(sel)) == 0) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    }
+
+    if (!options->only_tables && !options->table_filter) return true;
+
+    if (options->only_tables) {
+        for (const char **it = options->only_tables; *it; ++it) {
+            inistrv_t sel = strv__from_str(*it);
+            // 'name*' matches every table starting with 'name'
+            if (sel.len > 0 && sel.buf[sel.len - 1] == '*') {
+                sel.len--;
+                if (name.len >= sel.len && memcmp(name.buf, sel.buf, sel.len) == 0) {
+                    return true;
+                }
+            }
+            else if (strv__cmp(name, sel) == 0) {
+                return true;
+            }
+        }
+    }
+
+    if (options->table_filter) {
+        return options->table_filter(name, options->userdata);
+    }
+
+    return false;
+}
+
+static uint64_t ini__key_weight(ini_t *src, inistrv_t table_name, inistrv_t key, bool from_stats) {
+    // the weight of a key is the sum of the counts of all its duplicates in all
+    // the tables with the same name, so that they end up next to each other
+    // and in the same order
+    uint64_t weight = 0;
+    unsigned int count = ivec_len(src->tables);
+    unsigned int first = index__find(&src->index, src->tables, sizeof(initable_t), count, table_name);
+    for (unsigned int t = first; t != INI__NONE; ) {
+        initable_t *tab = src->tables + t;
+        unsigned int vcount = ivec_len(tab->values);
+        unsigned int vfirst = index__find(&tab->index, tab->values, sizeof(inivalue_t), vcount, key);
+        for (unsigned int v = vfirst; v != INI__NONE; ) {
+#ifdef INI_ACCESS_STATS
+            if (from_stats) weight += v < ivec_len(tab->hits) ? tab->hits[v] : 0;
+            else            weight += ini_as_uint(tab->values + v);
+#else
+            (void)from_stats;
+            weight += ini_as_uint(tab->values + v);
+#endif
+            v = index__next(&tab->index, tab->values, sizeof(inivalue_t), vcount, v);
+            if (v == vfirst) break;
+        }
+        t = index__next(&src->index, src->tables, sizeof(initable_t), count, t);
+        if (t == first) break;
+    }
+    return weight;
+}
+
+static void ini__sort_values(ini_t *ctx, initable_t *table, ini_t *profile) {
+    unsigned int count = ivec_len(table->values);
+    if (count < 2) return;
+
+    ini__rank_t *ranks = (ini__rank_t *)INI_MALLOC(sizeof(ini__rank_t) * count);
+    if (!ranks) return;
+    for (unsigned int i = 0; i < count; ++i) {
+        ranks[i].weight = ini__key_weight(
+            profile ? profile : ctx, table->name, table->values[i].key, !profile
+        );
+        ranks[i].pos = i;
+    }
+    qsort(ranks, count, sizeof(ini__rank_t), ini__rank_cmp);
+
+    // sorted in place, the vector might be part of a contiguous block
+    inivalue_t *values = (inivalue_t *)INI_MALLOC(sizeof(inivalue_t) * count);
+    if (!values) {
+        INI_FREE(ranks);
+        return;
+    }
+    memcpy(values, table->values, sizeof(inivalue_t) * count);
+    for (unsigned int i = 0; i < count; ++i) {
+        table->values[i] = values[ranks[i].pos];
+    }
+    INI_FREE(values);
+
+    if (ivec_len(table->short_keys) == count) {
+        inivec_t(inishortkey_t) short_keys = NULL;
+        (void)ivec_add(short_keys, count);
+        for (unsigned int i = 0; i < count; ++i) {
+            short_keys[i] = table->short_keys[ranks[i].pos];
+        }
+        ivec_free(table->short_keys);
+        table->short_keys = short_keys;
+    }
+
+#ifdef INI_ACCESS_STATS
+    if (ivec_len(table->hits) == count) {
+        inivec_t(unsigned int) hits = NULL;
+        (void)ivec_add(hits, count);
+        for (unsigned int i = 0; i < count; ++i) {
+            hits[i] = table->hits[ranks[i].pos];
+        }
+        ivec_free(table->hits);
+        table->hits = hits;
+    }
+#endif
+
+    INI_FREE(ranks);
+    bool sorted = table->index.sorted != NULL;
+    index__free(&table->index);
+    index__push(&table->index, table->values, sizeof(inivalue_t), count);
+    if (sorted) index__sort(&table->index, table->values, sizeof(inivalue_t), count);
+}
+
+static bool ini__group_has_key(ini_t *ctx, unsigned int first, unsigned int table, unsigned int value) {
+    // true if the key of <value> was already in <table> or in a table of the group before it
+    initable_t *tab = ctx->tables + table;
+    inistrv_t key = tab->values[value].key;
+    if (index__find(&tab->index, tab->values, sizeof(inivalue_t), ivec_len(tab->values), key) != value) {
+        return true;
+    }
+    unsigned int count = ivec_len(ctx->tables);
+    for (unsigned int t = first; t != table; ) {
+        if (t > 0 && ini__find_value_pos(ctx->tables + t, key) != INI__NONE) return true;
+        t = index__next(&ctx->index, ctx->tables, sizeof(initable_t), count, t);
+        if (t == first) break;
+    }
+    return false;
+}
+
+static void ini__sort_tables(ini_t *ctx, ini_t *profile) {
+    unsigned int count = ivec_len(ctx->tables);
+    if (count < 3) return;
+
+    // the root table doesn't move
+    unsigned int to_sort = count - 1;
+    initable_t *tables = ctx->tables + 1;
+
+    uint64_t *table_weights = (uint64_t *)INI_MALLOC(sizeof(uint64_t) * to_sort);
+    ini__rank_t *ranks = (ini__rank_t *)INI_MALLOC(sizeof(ini__rank_t) * to_sort);
+    if (!table_weights || !ranks) {
+        INI_FREE(table_weights);
+        INI_FREE(ranks);
+        return;
+    }
+
+    for (unsigned int i = 0; i < to_sort; ++i) {
+        table_weights[i] = UINT64_MAX;
+    }
+
+    // same as the values, duplicate tables share the weight of the whole group.
+    // ini__key_weight already sums a key over every table of the group, so each
+    // key is only counted the first time it shows up in the group
+    for (unsigned int i = 0; i < to_sort; ++i) {
+        ranks[i].pos = i;
+        if (table_weights[i] == UINT64_MAX) {
+            unsigned int first = index__find(&ctx->index, ctx->tables, sizeof(initable_t), count, tables[i].name);
+            uint64_t weight = 0;
+            for (unsigned int t = first; t != INI__NONE; ) {
+                initable_t *tab = ctx->tables + t;
+                for (unsigned int v = 0; t > 0 && v < ivec_len(tab->values); ++v) {
+                    if (!ini__group_has_key(ctx, first, t, v)) {
+                        weight += ini__key_weight(profile ? profile : ctx, tab->name, tab->values[v].key, !profile);
+                    }
+                }
+                t = index__next(&ctx->index, ctx->tables, sizeof(initable_t), count, t);
+                if (t == first) break;
+            }
+            for (unsigned int t = first; t != INI__NONE; ) {
+                if (t > 0) table_weights[t - 1] = weight;
+                t = index__next(&ctx->index, ctx->tables, sizeof(initable_t), count, t);
+                if (t == first) break;
+            }
+        }
+        ranks[i].weight = table_weights[i];
+    }
+    qsort(ranks, to_sort, sizeof(ini__rank_t), ini__rank_cmp);
+
+    initable_t *sorted = (initable_t *)INI_MALLOC(sizeof(initable_t) * to_sort);
+    if (sorted) {
+        for (unsigned int i = 0; i < to_sort; ++i) {
+            sorted[i] = tables[ranks[i].pos];
+        }
+        memcpy(tables, sorted, sizeof(initable_t) * to_sort);
+        INI_FREE(sorted);
+        bool was_sorted = ctx->index.sorted != NULL;
+        index__free(&ctx->index);
+        index__push(&ctx->index, ctx->tables, sizeof(initable_t), count);
+        if (was_sorted) index__sort(&ctx->index, ctx->tables, sizeof(initable_t), count);
+    }
+
+    INI_FREE(table_weights);
+    INI_FREE(ranks);
+}
+
+static int ini__rank_cmp(const void *a, const void *b) {
+    const ini__rank_t *ra = (const ini__rank_t *)a;
+    const ini__rank_t *rb = (const ini__rank_t *)b;
+    // heaviest first, ties keep the original order
+    if (ra->weight != rb->weight) return ra->weight > rb->weight ? -1 : 1;
+    return ra->pos < rb->pos ? -1 : ra->pos > rb->pos;
+}
+
+static uint32_t ini__bundle_add_str(ini__bundle_writer_t *w, inistrv_t str) {
+    unsigned int count = ivec_len(w->offsets);
+    unsigned int pos = index__find(&w->index, w->offsets, sizeof(ini__bundle_str_t), count, str);
+    if (pos != INI__NONE) return w->offsets[pos].off;
+
+    ini__bundle_str_t entry = { str, ivec_len(w->strings) };
+    char *dest = ivec_add(w->strings, str.len + 1);
+    if (str.len) memcpy(dest, str.buf, str.len);
+    dest[str.len] = '\0';
+    ivec_push(w->offsets, entry);
+    index__push(&w->index, w->offsets, sizeof(ini__bundle_str_t), count + 1);
+    return entry.off;
+}
+
+static inistrv_t ini__bundle_str(inibundle_t *bundle, uint32_t off, uint32_t len) {
+    const ini__bundle_header_t *header = (const ini__bundle_header_t *)bundle->data;
+    // out of bounds strings become empty instead of reading outside of the file
+    if ((uint64_t)off + len >= header->strings_len) return CDECL(inistrv_t){ NULL, 0 };
+    return CDECL(inistrv_t){ bundle->data + header->strings_off + off, len };
+}
+
+static uint64_t ini__pair_hash(inistrv_t key, inistrv_t value) {
+    // values can keep some whitespace before an inline comment
+    value = strv__trim(value);
+    return ini__hash(value.buf, value.len, ini__hash(key.buf, key.len, 0));
+}
+
+#define ini__group_next(ctx, t, first) ((t) = ini__group_step((ctx), (t), (first)))
+
+static unsigned int ini__group_first(ini_t *ctx, inistrv_t name) {
+    // the root table is also called "root", but a [root] section is a group of its own
+    unsigned int count = ivec_len(ctx->tables);
+    unsigned int first = index__find(&ctx->index, ctx->tables, sizeof(initable_t), count, name);
+    if (first == 0) {
+        first = index__next(&ctx->index, ctx->tables, sizeof(initable_t), count, 0);
+        if (first == 0) first = INI__NONE;
+    }
+    return first;
+}
+
+static unsigned int ini__group_step(ini_t *ctx, unsigned int t, unsigned int first) {
+    // the chain of an index goes around through the root table if a [root] section exists
+    unsigned int count = ivec_len(ctx->tables);
+    do {
+        t = index__next(&ctx->index, ctx->tables, sizeof(initable_t), count, t);
+    } while (t == 0 && first != 0);
+    return t == first ? INI__NONE : t;
+}
+
+static uint64_t ini__group_hash(ini_t *ctx, unsigned int first) {
+    // the root table is never part of a group
+    if (first == 0) return ctx->tables[0].hash;
+    uint64_t hash = 0;
+    for (unsigned int t = first; t != INI__NONE; ini__group_next(ctx, t, first)) {
+        hash += ctx->tables[t].hash;
+    }
+    return hash;
+}
+
+static inivalue_t *ini__group_get(ini_t *ctx, unsigned int first, inistrv_t key) {
+    if (first == INI__NONE) return NULL;
+    if (first == 0) return ini__find_value(ctx->tables, key);
+    for (unsigned int t = first; t != INI__NONE; ini__group_next(ctx, t, first)) {
+        inivalue_t *value = ini__find_value(ctx->tables + t, key);
+        if (value) return value;
+    }
+    return NULL;
+}
+
+static void ini__diff_group(inisubs_t *subs, ini_t *old_ctx, unsigned int old_first, ini_t *new_ctx, unsigned int new_first) {
+    ini_t *ctx = new_first != INI__NONE ? new_ctx : old_ctx;
+    unsigned int first = new_first != INI__NONE ? new_first : old_first;
+    // subscribers use an empty name for the root table
+    inistrv_t name = first == 0 ? CDECL(inistrv_t){ NULL, 0 } : ctx->tables[first].name;
+    unsigned int changes = 0;
+
+    // changed or added keys, only the first value of each key counts
+    for (unsigned int t = new_first; t != INI__NONE; ) {
+        initable_t *tab = new_ctx->tables + t;
+        for (inivalue_t *val = tab->values; val != ivec_end(tab->values); ++val) {
+            if (ini__group_get(new_ctx, new_first, val->key) != val) continue;
+            inivalue_t *old_val = ini__group_get(old_ctx, old_first, val->key);
+            if (!old_val || strv__cmp(old_val->value, val->value) != 0) {
+                ini__dispatch(subs, name, val->key, old_val, val);
+                changes++;
+            }
+        }
+        if (t == 0) break;
+        ini__group_next(new_ctx, t, new_first);
+    }
+
+    // removed keys
+    for (unsigned int t = old_first; t != INI__NONE; ) {
+        initable_t *tab = old_ctx->tables + t;
+        for (inivalue_t *val = tab->values; val != ivec_end(tab->values); ++val) {
+            if (ini__group_get(old_ctx, old_first, val->key) != val) continue;
+            if (!ini__group_get(new_ctx, new_first, val->key)) {
+                ini__dispatch(subs, name, val->key, val, NULL);
+                changes++;
+            }
+        }
+        if (t == 0) break;
+        ini__group_next(old_ctx, t, old_first);
+    }
+
+    // the hash also changes if only later duplicates changed, table
+    // subscribers are only called if one of the keys they can see did
+    if (changes) {
+        ini__dispatch(subs, name, CDECL(inistrv_t){ NULL, 0 }, NULL, NULL);
+    }
+}
+
+static void ini__dispatch(inisubs_t *subs, inistrv_t table, inistrv_t key, const inivalue_t *old_value, const inivalue_t *new_value) {
+    uint64_t hash = ini__hash(key.buf, key.len, ini__hash(table.buf, table.len, 0));
+    unsigned int mask = ivec_len(subs->slots) - 1;
+    for (unsigned int i = (unsigned int)hash & mask; subs->slots[i]; i = (i + 1) & mask) {
+        inisub_t *sub = subs->subs + subs->slots[i] - 1;
+        if (sub->hash == hash && strv__cmp(sub->key, key) == 0 && strv__cmp(sub->table, table) == 0) {
+            sub->fn(table, key, old_value, new_value, sub->userdata);
+            subs->calls++;
+        }
+    }
+}
+
+static inistrv_t ini__intern(inipool_t *pool, inistrv_t str) {
+    unsigned int count = ivec_len(pool->strings);
+    unsigned int pos = index__find(&pool->index, pool->strings, sizeof(inistrv_t), count, str);
+    if (pos != INI__NONE) return pool->strings[pos];
+
+    if (!pool->blocks || pool->block_used + str.len + 1 > pool->block_cap) {
+        size_t cap = str.len + 1 > 4096 ? str.len + 1 : 4096;
+        // zeroed so that the padding, and whatever is after the last string, can be read
+        char *block = (char *)INI_MALLOC(cap + INI_PADDING);
+        // the caller can't use <str> instead, it might be freed with the text
+        if (!block) return CDECL(inistrv_t){ NULL, 0 };
+        memset(block, 0, cap + INI_PADDING);
+        ivec_push(pool->blocks, block);
+        pool->block_used = 0;
+        pool->block_cap = cap;
+    }
+    char *copy = ivec_back(pool->blocks) + pool->block_used;
+    if (str.len) memcpy(copy, str.buf, str.len);
+    copy[str.len] = '\0';
+    pool->block_used += str.len + 1;
+
+    inistrv_t interned = { copy, str.len };
+    ivec_push(pool->strings, interned);
+    index__push(&pool->index, pool->strings, sizeof(inistrv_t), count + 1);
+    return interned;
+}
+
+static inideltaentry_t *ini__delta_find(inidelta_t *delta, inistrv_t table, inistrv_t key, bool insert) {
+    uint64_t hash = ini__hash(key.buf, key.len, ini__hash(table.buf, table.len, 0));
+    unsigned int mask = INI_DELTA_SLOTS - 1;
+    unsigned int i = (unsigned int)hash & mask;
+    for (; delta->used & (1ULL << i); i = (i + 1) & mask) {
+        inideltaentry_t *entry = delta->slots + i;
+        if (entry->hash == hash && 
+            strv__cmp(entry->value.key, key) == 0 && 
+            strv__cmp(entry->table, table) == 0
+        ) {
+            return entry;
+        }
+    }
+    if (!insert || delta->count >= INI_DELTA_SLOTS * 3 / 4) return NULL;
+
+    inideltaentry_t *entry = delta->slots + i;
+    entry->hash = hash;
+    entry->table = table;
+    entry->value.key = key;
+    entry->value.value = CDECL(inistrv_t){ NULL, 0 };
+    entry->removed = false;
+    delta->used |= 1ULL << i;
+    delta->count++;
+    return entry;
+}
+
+static bool ini__is_key_selected(const initable_t *table, inistrv_t key, ini__parser_t *p) {
+    if (!p->keyset.keys) return true;
+
+    ini__keyset_t *set = &p->keyset;
+    bool is_root = table->name.buf == ini__root_name.buf;
+    inistrv_t name = is_root ? CDECL(inistrv_t){ NULL, 0 } : table->name;
+    // values of the same table come one after the other, so only hash its name once
+    if (set->hashed_table != table->name.buf) {
+        set->hashed_table = table->name.buf;
+        set->table_hash = ini__hash(name.buf, name.len, 0);
+    }
+
+    unsigned int mask = ivec_len(set->keys) - 1;
+    unsigned int i = (unsigned int)ini__hash(key.buf, key.len, set->table_hash) & mask;
+    for (; set->keys[i]; i = (i + 1) & mask) {
+        const inikeysel_t *sel = &p->opts.only_keys[set->keys[i] - 1];
+        if (strv__cmp(key, strv__from_str(sel->key)) == 0 &&
+            strv__cmp(name, strv__from_str(sel->table)) == 0
+        ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inivalue_t *ini__find_value(initable_t *table, inistrv_t key) {
+    unsigned int pos = ini__find_value_pos(table, key);
+    return pos != INI__NONE ? table->values + pos : NULL;
+}
+
+static unsigned int ini__find_value_pos(initable_t *table, inistrv_t key) {
+    if (strv__is_empty(key)) return INI__NONE;
+    unsigned int count = ivec_len(table->values);
+    // tables without an index compare every key, with inline keys that doesn't touch the text
+    if (!table->index.slots && count && ivec_len(table->short_keys) == count) {
+        inishortkey_t probe = ini__short_key(key);
+        for (unsigned int i = 0; i < count; ++i) {
+            const inishortkey_t *cur = table->short_keys + i;
+            if (probe.len != INI__LONG_KEY
+                ? ini__short_key_eq(&probe, cur)
+                : cur->len == INI__LONG_KEY && strv__cmp(table->values[i].key, key) == 0
+            ) {
+                return i;
+            }
+        }
+        return INI__NONE;
+    }
+    return index__find(
+        &table->index, table->values, sizeof(inivalue_t), ivec_len(table->values), key
+    );
+}
+
+static inishortkey_t ini__short_key(inistrv_t key) {
+    inishortkey_t short_key;
+    memset(&short_key, 0, sizeof(short_key));
+    if (key.len <= sizeof(short_key.buf)) {
+        if (key.len) memcpy(short_key.buf, key.buf, key.len);
+        short_key.len = (unsigned char)key.len;
+    }
+    else {
+        short_key.len = INI__LONG_KEY;
+    }
+    return short_key;
+}
+
+static bool ini__short_key_eq(const inishortkey_t *a, const inishortkey_t *b) {
+    uint64_t a_words[2], b_words[2];
+    memcpy(a_words, a, sizeof(a_words));
+    memcpy(b_words, b, sizeof(b_words));
+    return a_words[0] == b_words[0] && a_words[1] == b_words[1];
+}
+
+static void ini__add_table(ini_t *ctx, ini__istream_t *in, ini__parser_t *p) {
+    const char *line_start = in->cur;
+    istr__skip(in); // skip [
+    inistrv_t name = istr__get_view(in, ']');
+    istr__skip(in); // skip ]
+
+    if (strv__is_empty(name)) return;
+
+    if (!ini__is_table_selected(name, p)) {
+        istr__ignore(in, '\n');
+        istr__skip_table(in);
+        ini__check_cancel(p, in);
+        return;
+    }
+
+    if (p->opts.intern_pool) {
+        name = ini__intern(p->opts.intern_pool, name);
+        if (!name.buf) {
+            p->error = INI_OUT_OF_MEMORY;
+            return;
+        }
+    }
+
+    initable_t *table = p->opts.merge_duplicate_tables ? ini__find_table(ctx, name) : NULL;
+    if (!table) {
+        if (p->opts.max_tables && p->tables >= p->opts.max_tables) {
+            p->error = INI_LIMIT_TABLES;
+            return;
+        }
+        p->tables++;
+        initable_t new_table = {0};
+        new_table.name = name;
+        table = ini__push_table(ctx, new_table, p);
+    }
+    istr__ignore(in, '\n');
+    istr__skip(in);
+    ini__check_line(p, in, line_start);
+    while (!istr__is_finished(in) && !p->error) {
+        line_start = in->cur;
+        switch (*in->cur) {
+            case '\n': case '\r':
+                return;
+            case '#': case ';':
+                istr__ignore(in, '\n');
+                ini__check_line(p, in, line_start);
+                break;
+            default:
+                ini__add_value(table, in, p);
+                break;
+        }
+    }
+}
+
+static void ini__add_value(initable_t *table, ini__istream_t *in, ini__parser_t *p) {
+    if (!table) return;
+    const char *line_start = in->cur;
+
+    inistrv_t key = strv__trim(istr__get_view(in, p->opts.key_value_divider));
+    istr__skip(in); // skip divider
+    inistrv_t val = strv__trim(istr__get_view(in, '\n'));
+
+    if (strv__is_empty(key)) return;
+
+    // find inline comments
+    for (size_t i = 0; i < val.len; ++i) {
+        if (val.buf[i] == '#' || val.buf[i] == ';') {
+            // can escape # and ; with a backslash (e.g. \#)
+            if (i > 0 && val.buf[i-1] == '\\') {
+                continue;
+            }
+            val.len = i;
+            break;
+        }
+    }
+
+    // value might be until EOF, in that case no use in skipping
+    if (!istr__is_finished(in)) istr__skip(in); // skip \n
+    ini__check_line(p, in, line_start);
+    if (p->error || !ini__is_key_selected(table, key, p)) return;
+    if (p->opts.intern_pool) {
+        key = ini__intern(p->opts.intern_pool, key);
+        if (p->opts.intern_values) {
+            val = ini__intern(p->opts.intern_pool, val);
+        }
+        if (!key.buf || !val.buf) {
+            p->error = INI_OUT_OF_MEMORY;
+            return;
+        }
+    }
+    inivalue_t *new_val = p->opts.override_duplicate_keys ? ini__find_value(table, key) : NULL;
     if (new_val) {
+        table->hash -= ini__pair_hash(new_val->key, new_val->value);
+        table->hash += ini__pair_hash(key, val);
         new_val->value = val;
     }
     else {
-        ivec_push(table->values, CDECL(inivalue_t){ key, val });
+        if (p->opts.max_keys && p->keys >= p->opts.max_keys) {
+            p->error = INI_LIMIT_KEYS;
+            return;
+        }
+        // while counting for ini_parse_into the values are not stored, this is checked on the second pass
+        if (p->opts.max_table_keys && ivec_len(table->values) >= p->opts.max_table_keys) {
+            p->error = INI_LIMIT_TABLE_KEYS;
+            return;
+        }
+        p->keys++;
+        table->hash += ini__pair_hash(key, val);
+        ini__push_value(table, CDECL(inivalue_t){ key, val }, p);
     }
 }
 
 static char *ini__strdup(const char *src, size_t len) {
     if (!src || len == 0) return NULL;
-    char *buf = (char *)malloc(len + 1);
+    char *buf = (char *)INI_MALLOC(len + 1);
     if (!buf) return NULL;
     memcpy(buf, src, len);
     buf[len] = '\0';
     return buf;
 }
 
+static const char *ini__num_str(inistrv_t value, char *buf, size_t buflen) {
+    // values don't always end with a terminator (ini_parse_into, borrow_buffer),
+    // so strtoll & co. get a terminated copy and can't read past the value
+    size_t len = value.len < buflen - 1 ? value.len : buflen - 1;
+    memcpy(buf, value.buf, len);
+    buf[len] = '\0';
+    return buf;
+}
+
+static char *ini__strdup_padded(const char *src, size_t len) {
+    // for buffers owned by the parser, strings given to the user don't need it
+    if (!src || len == 0) return NULL;
+    char *buf = (char *)INI_MALLOC(len + INI_PADDING);
+    if (!buf) return NULL;
+    memcpy(buf, src, len);
+    memset(buf + len, 0, INI_PADDING);
+    return buf;
+}
+
 static int ini__rem_escaped(inistrv_t value, char *buf, size_t buflen) {
     if (!buf || buflen == 0) return INI_INVALID_ARGS;
     if (strv__is_empty(value)) {
@@ -594,6 +3050,323 @@ static int ini__rem_escaped(inistrv_t value, char *buf, size_t buflen) {
     return dest_pos;
 }
 
+static uint64_t ini__hash_mix(uint64_t h) {
+    // murmur3 finalizer
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// multiplies a and b to 128 bits and folds the two halves together
+static uint64_t ini__mum(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+    uint64_t alo = a & 0xffffffff, ahi = a >> 32;
+    uint64_t blo = b & 0xffffffff, bhi = b >> 32;
+    uint64_t lo = alo * blo, mid1 = ahi * blo, mid2 = alo * bhi, hi = ahi * bhi;
+    uint64_t mid = (lo >> 32) + (mid1 & 0xffffffff) + (mid2 & 0xffffffff);
+    hi += (mid1 >> 32) + (mid2 >> 32) + (mid >> 32);
+    lo = (lo & 0xffffffff) | (mid << 32);
+    return lo ^ hi;
+#endif
+}
+
+static uint64_t ini__hash(const void *data, size_t len, uint64_t seed) {
+    // wyhash style: every word goes through a full multiplication with the
+    // seed mixed in, so which names collide depends on the seed and can't
+    // be worked out without knowing it
+    const uint64_t k1 = 0xa0761d6478bd642fULL;
+    const uint64_t k2 = 0xe7037ed1a0b428dbULL;
+    const unsigned char *src = (const unsigned char *)data;
+    uint64_t h = ini__mum(seed ^ k1, len ^ k2);
+    uint64_t word;
+    for (; len >= 8; src += 8, len -= 8) {
+        memcpy(&word, src, 8);
+        h = ini__mum(word ^ seed ^ k1, h ^ k2);
+    }
+    if (len > 0) {
+        word = 0;
+        memcpy(&word, src, len);
+        h = ini__mum(word ^ seed ^ k1, h ^ k2);
+    }
+    return ini__hash_mix(h ^ seed);
+}
+
+#define index__name(items, stride, i) (*(const inistrv_t *)((const char *)(items) + (size_t)(i) * (stride)))
+
+// the index is only valid if it was kept up to date with the items, if
+// someone pushed into the vector by hand we fall back to a linear search
+#define index__is_valid(index, count) ((index)->slots && ivec_len((index)->chain) == (count))
+
+static unsigned int index__probe(const iniindex_t *index, const void *items, size_t stride, inistrv_t name) {
+    unsigned int mask = ivec_len(index->slots) - 1;
+    unsigned int i = (unsigned int)ini__hash(name.buf, name.len, INI_HASH_SEED) & mask;
+    for (; index->slots[i]; i = (i + 1) & mask) {
+        if (strv__cmp(index__name(items, stride, index->slots[i] - 1), name) == 0) {
+            break;
+        }
+    }
+    return i;
+}
+
+static void index__rehash(iniindex_t *index, const void *items, size_t stride, unsigned int cap) {
+    INI__PROBE2(index_build, ivec_len(index->chain), cap);
+    inivec_t(unsigned int) old = index->slots;
+    index->slots = NULL;
+    memset(ivec_add(index->slots, cap), 0, sizeof(unsigned int) * cap);
+    for (unsigned int i = 0; i < ivec_len(old); ++i) {
+        if (old[i]) {
+            inistrv_t name = index__name(items, stride, old[i] - 1);
+            index->slots[index__probe(index, items, stride, name)] = old[i];
+        }
+    }
+    ivec_free(old);
+}
+
+static void index__add(iniindex_t *index, const void *items, size_t stride, unsigned int pos) {
+    // keep the load factor under 0.5
+    if ((pos + 1) * 2 > ivec_len(index->slots)) {
+        index__rehash(index, items, stride, ivec_len(index->slots) * 2);
+    }
+    unsigned int slot = index__probe(index, items, stride, index__name(items, stride, pos));
+    unsigned int last = index->slots[slot];
+    if (last) {
+        // append to the circular chain, last -> pos -> first
+        index->chain[pos] = index->chain[last - 1];
+        index->chain[last - 1] = pos;
+    }
+    else {
+        index->chain[pos] = pos;
+    }
+    index->slots[slot] = pos + 1;
+}
+
+static void index__push(iniindex_t *index, const void *items, size_t stride, unsigned int count) {
+    if (!index->slots) {
+        if (count < INI__INDEX_MIN) return;
+        // first time going over the threshold, index everything so far
+        // leave room for the items that come next, so that it doesn't rehash right away
+        unsigned int cap = 16;
+        while (cap < count * 4) cap *= 2;
+        INI__PROBE2(index_build, count, cap);
+        memset(ivec_add(index->slots, cap), 0, sizeof(unsigned int) * cap);
+        // the chain can grow up to half of the slots before the next rehash
+        ivec_reserve(index->chain, cap / 2 + 1);
+        (void)ivec_add(index->chain, count);
+        for (unsigned int i = 0; i < count; ++i) {
+            index__add(index, items, stride, i);
+        }
+        return;
+    }
+    if (ivec_len(index->chain) + 1 != count) return;
+    (void)ivec_add(index->chain, 1);
+    index__add(index, items, stride, count - 1);
+}
+
+static unsigned int index__find(const iniindex_t *index, const void *items, size_t stride, unsigned int count, inistrv_t name) {
+    if (index__is_valid(index, count)) {
+        unsigned int last = index->slots[index__probe(index, items, stride, name)];
+        return last ? index->chain[last - 1] : INI__NONE;
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+        if (strv__cmp(index__name(items, stride, i), name) == 0) {
+            return i;
+        }
+    }
+    return INI__NONE;
+}
+
+static unsigned int index__next(const iniindex_t *index, const void *items, size_t stride, unsigned int count, unsigned int pos) {
+    if (index__is_valid(index, count)) {
+        return index->chain[pos];
+    }
+    // not indexed, go through the rest of the items
+    inistrv_t name = index__name(items, stride, pos);
+    for (unsigned int i = pos + 1; i < count; ++i) {
+        if (strv__cmp(index__name(items, stride, i), name) == 0) {
+            return i;
+        }
+    }
+    return INI__NONE;
+}
+
+static int index__sortkey_cmp(const void *a, const void *b) {
+    const ini__sortkey_t *ka = (const ini__sortkey_t *)a;
+    const ini__sortkey_t *kb = (const ini__sortkey_t *)b;
+    int cmp = strv__cmp_lex(ka->name, kb->name);
+    if (cmp) return cmp;
+    return ka->pos < kb->pos ? -1 : ka->pos > kb->pos;
+}
+
+static void index__sort(iniindex_t *index, const void *items, size_t stride, unsigned int count) {
+    ivec_free(index->sorted);
+    index->sorted = NULL;
+    // small tables are faster to just go through
+    if (count < INI__INDEX_MIN) return;
+
+    ini__sortkey_t *keys = (ini__sortkey_t *)INI_MALLOC(sizeof(ini__sortkey_t) * count);
+    if (!keys) return;
+    for (unsigned int i = 0; i < count; ++i) {
+        keys[i].name = index__name(items, stride, i);
+        keys[i].pos = i;
+    }
+    qsort(keys, count, sizeof(ini__sortkey_t), index__sortkey_cmp);
+    unsigned int *sorted = ivec_add(index->sorted, count);
+    for (unsigned int i = 0; i < count; ++i) {
+        sorted[i] = keys[i].pos;
+    }
+    INI_FREE(keys);
+}
+
+static void index__match(const iniindex_t *index, const void *items, size_t stride, unsigned int count, inistrv_t pattern, void (*fn)(unsigned int pos, void *udata), void *udata) {
+    size_t wildcard = 0;
+    while (wildcard < pattern.len && pattern.buf[wildcard] != '*' && pattern.buf[wildcard] != '?') {
+        ++wildcard;
+    }
+
+    // no wildcards, simply follow the chain of items with that name
+    if (wildcard == pattern.len) {
+        unsigned int first = index__find(index, items, stride, count, pattern);
+        for (unsigned int i = first; i != INI__NONE; ) {
+            fn(i, udata);
+            i = index__next(index, items, stride, count, i);
+            if (i == first) break;
+        }
+        return;
+    }
+
+    // fixed prefix, binary search for the first item that starts with it
+    // and go through the sorted items until they don't anymore
+    if (wildcard > 0 && index->sorted && ivec_len(index->sorted) == count) {
+        inistrv_t prefix = { pattern.buf, wildcard };
+        unsigned int lo = 0, hi = count;
+        while (lo < hi) {
+            unsigned int mid = lo + (hi - lo) / 2;
+            if (strv__cmp_lex(index__name(items, stride, index->sorted[mid]), prefix) < 0) lo = mid + 1;
+            else                                                                        hi = mid;
+        }
+        for (; lo < count; ++lo) {
+            unsigned int pos = index->sorted[lo];
+            inistrv_t name = index__name(items, stride, pos);
+            if (name.len < prefix.len || memcmp(name.buf, prefix.buf, prefix.len) != 0) break;
+            if (strv__glob(pattern, name)) fn(pos, udata);
+        }
+        return;
+    }
+
+    // otherwise check every item, but first look for the longest piece of the
+    // pattern without wildcards, which rules out most items with a single memchr
+    inistrv_t literal = { NULL, 0 };
+    for (size_t i = 0; i < pattern.len; ) {
+        size_t start = i;
+        while (i < pattern.len && pattern.buf[i] != '*' && pattern.buf[i] != '?') ++i;
+        if (i - start > literal.len) literal = CDECL(inistrv_t){ pattern.buf + start, i - start };
+        ++i;
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+        inistrv_t name = index__name(items, stride, i);
+        if (strv__contains(name, literal) && strv__glob(pattern, name)) {
+            fn(i, udata);
+        }
+    }
+}
+
+static void index__free(iniindex_t *index) {
+    ivec_free(index->slots);
+    ivec_free(index->chain);
+    ivec_free(index->sorted);
+    *index = CDECL(iniindex_t){0};
+}
+
+static uint64_t ini__rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+#define INI__BULK_K1 0x9e3779b97f4a7c15ULL
+#define INI__BULK_K2 0xc2b2ae3d27d4eb4fULL
+
+static uint64_t ini__hash_bulk(const void *data, size_t len, uint64_t seed) {
+    // same idea as ini__hash, but with 4 independent lanes so that the
+    // multiplications can run in parallel on big buffers
+    if (len < 32) return ini__hash(data, len, seed);
+    ini__bulkhash_t h;
+    ini__hash_bulk_init(&h, data, seed);
+    return ini__hash_bulk_end(&h, len);
+}
+
+static void ini__hash_bulk_init(ini__bulkhash_t *h, const void *data, uint64_t seed) {
+    h->lanes[0] = seed + INI__BULK_K1;
+    h->lanes[1] = seed ^ INI__BULK_K2;
+    h->lanes[2] = seed - INI__BULK_K1;
+    h->lanes[3] = ~seed;
+    h->seed = seed;
+    h->start = h->next = (const unsigned char *)data;
+}
+
+static void ini__hash_bulk_feed(ini__bulkhash_t *h, const void *upto) {
+    // only whole blocks, the rest waits for the next call
+    const unsigned char *end = (const unsigned char *)upto;
+    for (; end - h->next >= 32; h->next += 32) {
+        for (int i = 0; i < 4; ++i) {
+            uint64_t word;
+            memcpy(&word, h->next + i * 8, 8);
+            h->lanes[i] = ini__rotl(h->lanes[i] ^ (word * INI__BULK_K2), 31) * INI__BULK_K1;
+        }
+    }
+}
+
+// <len> is the length of the whole buffer, whatever was fed so far
+static uint64_t ini__hash_bulk_end(ini__bulkhash_t *h, size_t len) {
+    if (len < 32) return ini__hash(h->start, len, h->seed);
+    ini__hash_bulk_feed(h, h->start + len);
+    uint64_t *lanes = h->lanes;
+    uint64_t mix = ini__rotl(lanes[0], 1) + ini__rotl(lanes[1], 7) + ini__rotl(lanes[2], 12) + ini__rotl(lanes[3], 18);
+    return ini__hash(h->next, (size_t)(h->start + len - h->next), mix ^ (len * INI__BULK_K2));
+}
+
+static void keyset__init(ini__keyset_t *set, const inikeysel_t *sel) {
+    *set = CDECL(ini__keyset_t){0};
+    if (!sel) return;
+
+    unsigned int count = 0;
+    while (sel[count].key) ++count;
+
+    // keep the load factor under 0.5, the selector list is usually tiny
+    unsigned int cap = 4;
+    while (cap < count * 2) cap *= 2;
+    memset(ivec_add(set->keys, cap), 0, sizeof(unsigned int) * cap);
+    memset(ivec_add(set->tables, cap), 0, sizeof(unsigned int) * cap);
+
+    for (unsigned int i = 0; i < count; ++i) {
+        inistrv_t table = strv__from_str(sel[i].table);
+        inistrv_t key = strv__from_str(sel[i].key);
+        uint64_t table_hash = ini__hash(table.buf, table.len, 0);
+        keyset__insert(set->keys, ini__hash(key.buf, key.len, table_hash), i);
+        if (sel[i].table) {
+            keyset__insert(set->tables, table_hash, i);
+        }
+    }
+}
+
+static void keyset__free(ini__keyset_t *set) {
+    ivec_free(set->keys);
+    ivec_free(set->tables);
+    *set = CDECL(ini__keyset_t){0};
+}
+
+static void keyset__insert(inivec_t(unsigned int) slots, uint64_t hash, unsigned int index) {
+    // duplicates are fine, they only cost a probe
+    unsigned int mask = ivec_len(slots) - 1;
+    unsigned int i = (unsigned int)hash & mask;
+    while (slots[i]) i = (i + 1) & mask;
+    slots[i] = index + 1;
+}
+
 static ini__istream_t istr__init(const char *str, size_t len) {
     return CDECL(ini__istream_t) { str, str, len };
 }
@@ -611,13 +3384,43 @@ static void istr__skip_whitespace(ini__istream_t *in) {
 
 static void istr__ignore(ini__istream_t *in, char delim) {
     const char *end = in->start + in->len;
-    for (; in->cur < end && *in->cur != delim; ++in->cur);
+    if (in->cur >= end) return;
+    // memchr is vectorized, which matters for very long lines
+    const char *found = (const char *)memchr(in->cur, delim, (size_t)(end - in->cur));
+    in->cur = found ? found : end;
 }
 
 static void istr__skip(ini__istream_t *in) {
     if (!istr__is_finished(in)) ++in->cur;
 }
 
+static void istr__skip_table(ini__istream_t *in) {
+    // a table ends at the first empty or comment line, like in ini__add_table, or
+    // at the next line that starts with '['. only the first bytes of each line are
+    // looked at, the newlines are found with memchr which is usually vectorized
+    const char *end = in->start + in->len;
+    const char *cur = in->cur;
+    while (cur < end) {
+        const char *newline = (const char *)memchr(cur, '\n', end - cur);
+        if (!newline) break;
+        const char *line = newline + 1;
+        if (line < end && (*line == '\n' || *line == '\r' || *line == '#' || *line == ';')) {
+            in->cur = line;
+            return;
+        }
+        const char *first = line;
+        while (first < end && (*first == ' ' || *first == '\t')) {
+            ++first;
+        }
+        if (first < end && *first == '[') {
+            in->cur = first;
+            return;
+        }
+        cur = line;
+    }
+    in->cur = end;
+}
+
 static inistrv_t istr__get_view(ini__istream_t *in, char delim) {
     const char *from = in->cur;
     istr__ignore(in, delim);
@@ -658,7 +3461,55 @@ static bool strv__is_empty(inistrv_t view) {
 static int strv__cmp(inistrv_t a, inistrv_t b) {
     if(a.len < b.len) return -1;
     if(a.len > b.len) return  1;
-    return memcmp(a.buf, b.buf, a.len);
+    // interned strings are equal only if they are the same pointer
+    if(a.buf == b.buf) return 0;
+    return a.len ? memcmp(a.buf, b.buf, a.len) : 0;
+}
+
+static int strv__cmp_lex(inistrv_t a, inistrv_t b) {
+    size_t len = a.len < b.len ? a.len : b.len;
+    int cmp = len ? memcmp(a.buf, b.buf, len) : 0;
+    if (cmp) return cmp;
+    return a.len < b.len ? -1 : a.len > b.len;
+}
+
+static bool strv__glob(inistrv_t pattern, inistrv_t str) {
+    size_t p = 0, s = 0;
+    // where to go back to when a '*' has to eat one more character
+    size_t star = SIZE_MAX, star_s = 0;
+    while (s < str.len) {
+        if (p < pattern.len && (pattern.buf[p] == '?' || pattern.buf[p] == str.buf[s])) {
+            ++p;
+            ++s;
+        }
+        else if (p < pattern.len && pattern.buf[p] == '*') {
+            star = p++;
+            star_s = s;
+        }
+        else if (star != SIZE_MAX) {
+            p = star + 1;
+            s = ++star_s;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.len && pattern.buf[p] == '*') ++p;
+    return p == pattern.len;
+}
+
+static bool strv__contains(inistrv_t str, inistrv_t sub) {
+    if (sub.len == 0) return true;
+    if (sub.len > str.len) return false;
+    const char *cur = str.buf;
+    const char *last = str.buf + str.len - sub.len;
+    while (cur <= last) {
+        cur = (const char *)memchr(cur, sub.buf[0], last - cur + 1);
+        if (!cur) return false;
+        if (memcmp(cur, sub.buf, sub.len) == 0) return true;
+        ++cur;
+    }
+    return false;
 }
 
 #endif
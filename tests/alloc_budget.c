@@ -0,0 +1,209 @@
+// counts every allocation made through the INI_MALLOC hooks and checks
+// that parsing stays within a budget and that lookups don't allocate at all
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static unsigned long long allocs;   // new blocks
+static unsigned long long reallocs; // blocks that were grown
+static unsigned long long frees;
+static size_t last_malloc;          // size of the last INI_MALLOC
+static bool fail_mallocs;           // every INI_MALLOC returns NULL
+
+static void *count_malloc(size_t size) {
+    if (fail_mallocs) return NULL;
+    allocs++;
+    last_malloc = size;
+    return malloc(size);
+}
+
+static void *count_realloc(void *ptr, size_t size) {
+    if (ptr) reallocs++;
+    else     allocs++;
+    return realloc(ptr, size);
+}
+
+static void count_free(void *ptr) {
+    if (ptr) frees++;
+    free(ptr);
+}
+
+#define INI_MALLOC(size)        count_malloc(size)
+#define INI_REALLOC(ptr, size)  count_realloc(ptr, size)
+#define INI_FREE(ptr)           count_free(ptr)
+#define INI_IMPLEMENTATION
+#include "../ini.h"
+
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static void reset(void) {
+    allocs = reallocs = frees = 0;
+}
+
+static char *gen_wide(unsigned int keys, size_t *len) {
+    char *buf = (char *)malloc((size_t)keys * 32 + 32);
+    size_t n = (size_t)sprintf(buf, "[wide]\n");
+    for (unsigned int i = 0; i < keys; ++i) {
+        n += (size_t)sprintf(buf + n, "key%u = %u\n", i, i);
+    }
+    *len = n;
+    return buf;
+}
+
+static char *gen_tables(unsigned int tables, size_t *len) {
+    char *buf = (char *)malloc((size_t)tables * 64 + 32);
+    size_t n = 0;
+    for (unsigned int i = 0; i < tables; ++i) {
+        n += (size_t)sprintf(buf + n, "[table%u]\nhost = h%u\nport = %u\n\n", i, i, i);
+    }
+    *len = n;
+    return buf;
+}
+
+static void test_tiny(void) {
+    const char *text =
+        "name = server\n"
+        "[net]\n"
+        "port = 8080\n"
+        "host = localhost\n";
+    reset();
+    ini_t ini = ini_parse_str(text, NULL);
+    CHECK(ini_is_valid(&ini), "tiny config didn't parse");
+    // text copy, tables, root values, net values, storage
+    CHECK(allocs <= 5, "tiny config: %llu allocations", allocs);
+    CHECK(reallocs == 0, "tiny config: %llu reallocs", reallocs);
+    ini_free(&ini);
+    CHECK(allocs == frees, "tiny config: %llu allocations but %llu frees", allocs, frees);
+
+    // only buffers owned by the parser are padded, not the strings given to the user
+    ini = ini_parse_str(text, NULL);
+    reset();
+    char *host = ini_as_str(ini_get(ini_get_table(&ini, "net"), "host"), false);
+    CHECK(allocs == 1 && last_malloc == strlen("localhost") + 1, "ini_as_str allocated %zu bytes", last_malloc);
+    INI_FREE(host);
+    ini_free(&ini);
+}
+
+static void test_wide(void) {
+    const unsigned int keys = 100000;
+    size_t len;
+    char *text = gen_wide(keys, &len);
+    reset();
+    ini_t ini = ini_parse_buf(text, len, NULL);
+    CHECK(ini_is_valid(&ini), "wide table didn't parse");
+    CHECK(ivec_len(ini.tables) == 2 && ivec_len(ini.tables[1].values) == keys, "wide table: wrong shape");
+    // vectors and indexes grow geometrically, so log(N) allocations and reallocs
+    CHECK(allocs <= 32, "wide table: %llu allocations", allocs);
+    CHECK(reallocs <= 32, "wide table: %llu reallocs", reallocs);
+    ini_free(&ini);
+    CHECK(allocs == frees, "wide table: %llu allocations but %llu frees", allocs, frees);
+    free(text);
+}
+
+static void test_tables(void) {
+    const unsigned int tables = 100000;
+    size_t len;
+    char *text = gen_tables(tables, &len);
+    reset();
+    ini_t ini = ini_parse_buf(text, len, NULL);
+    CHECK(ini_is_valid(&ini), "many tables didn't parse");
+    CHECK(ivec_len(ini.tables) == tables + 1, "many tables: wrong shape");
+    // one vector of values per table, but they never grow
+    CHECK(allocs <= tables + 32, "many tables: %llu allocations", allocs);
+    CHECK(reallocs <= 32, "many tables: %llu reallocs", reallocs);
+    ini_free(&ini);
+    CHECK(allocs == frees, "many tables: %llu allocations but %llu frees", allocs, frees);
+    free(text);
+}
+
+static void test_lookups(const iniopts_t *opts) {
+    size_t len;
+    char *text = gen_tables(1000, &len);
+    ini_t ini = ini_parse_buf(text, len, opts);
+    size_t wide_len;
+    char *wide_text = gen_wide(1000, &wide_len);
+    ini_t wide = ini_parse_buf(wide_text, wide_len, opts);
+
+    reset();
+    char buf[64];
+    long long sum = 0;
+    for (unsigned int i = 0; i < 1000; ++i) {
+        char name[32];
+        sprintf(name, "table%u", i);
+        initable_t *tab = ini_get_table(&ini, name);
+        sum += ini_as_int(ini_get(tab, "port"));
+        sum += ini_as_uint(ini_get(tab, "port"));
+        sum += (long long)ini_as_num(ini_get(tab, "port"));
+        sum += ini_to_str(ini_get(tab, "host"), buf, sizeof(buf), false);
+        sum += ini_get(tab, "missing") == NULL;
+
+        sprintf(name, "key%u", i);
+        sum += ini_as_int(ini_get(ini_get_table(&wide, "wide"), name));
+    }
+    iniiter_t it = ini_get_all(ini_get_table(&wide, "wide"), "key10");
+    for (inivalue_t *v = ini_iter_next(&it); v; v = ini_iter_next(&it)) sum++;
+    initableiter_t tit = ini_table_iter(&ini, "table10");
+    for (initable_t *t = ini_table_next(&tit); t; t = ini_table_next(&tit)) sum++;
+    CHECK(sum > 0, "lookups found nothing");
+    CHECK(allocs == 0 && reallocs == 0 && frees == 0,
+        "lookups: %llu allocations, %llu reallocs, %llu frees", allocs, reallocs, frees);
+
+    ini_free(&ini);
+    ini_free(&wide);
+    free(text);
+    free(wide_text);
+}
+
+static void test_parse_into(void) {
+    const char *text = "[a]\nx = 1\ny = 2\n\n[b]\nz = 3\n";
+    static char mem[4096];
+    reset();
+    ini_t ini = ini_parse_into(text, strlen(text), mem, sizeof(mem), NULL);
+    CHECK(ini_is_valid(&ini), "parse_into failed: %s", ini_explain(ini.error));
+    CHECK(ini_as_int(ini_get(ini_get_table(&ini, "b"), "z")) == 3, "parse_into: wrong value");
+    ini_free(&ini);
+    CHECK(allocs == 0 && reallocs == 0 && frees == 0,
+        "parse_into: %llu allocations, %llu reallocs, %llu frees", allocs, reallocs, frees);
+}
+
+static void test_out_of_memory(void) {
+    const char *text = "[server]\nhost = localhost\nport = 8080\n";
+    inipool_t pool = {0};
+    // the buffer isn't copied, so the first allocation to fail is the pool's
+    reset();
+    fail_mallocs = true;
+    ini_t ini = ini_parse_buf(text, strlen(text), &(iniopts_t){
+        .intern_pool = &pool, .intern_values = true, .borrow_buffer = true,
+    });
+    fail_mallocs = false;
+    CHECK(!ini_is_valid(&ini) && ini.error == INI_OUT_OF_MEMORY,
+        "interning without memory should fail the parse, got %s", ini_explain(ini.error));
+    ini_pool_free(&pool);
+    CHECK(allocs == frees, "out of memory: %llu allocations but %llu frees", allocs, frees);
+
+    // copying the buffer is the first allocation
+    fail_mallocs = true;
+    ini = ini_parse_str(text, NULL);
+    fail_mallocs = false;
+    CHECK(!ini_is_valid(&ini) && ini.error == INI_OUT_OF_MEMORY,
+        "failing to copy the buffer should fail the parse, got %s", ini_explain(ini.error));
+}
+
+int main(void) {
+    test_tiny();
+    test_wide();
+    test_tables();
+    test_lookups(NULL);
+    test_lookups(&(iniopts_t){ .lookup_index = true });
+    test_parse_into();
+    test_out_of_memory();
+    if (failures) {
+        printf("alloc_budget: %d failures\n", failures);
+        return 1;
+    }
+    printf("alloc_budget: ok\n");
+    return 0;
+}
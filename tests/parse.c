@@ -0,0 +1,662 @@
+// regression tests for the parser options
+#include <stdio.h>
+#include <stdlib.h>
+
+// the access counters are compiled in, so every test also runs with them
+#define INI_ACCESS_STATS
+#define INI_IMPLEMENTATION
+#include "../ini.h"
+
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { failures++; printf("FAIL %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } while (0)
+
+static void test_inline_keys(void) {
+    char buf[1024];
+    int n = sprintf(buf, "[small]\na = 1\nb = 2\n\n[wide]\n");
+    for (int i = 0; i < 20; ++i) n += sprintf(buf + n, "key%d = %d\n", i, i);
+    for (int indexed = 0; indexed < 2; ++indexed) {
+        ini_t ini = ini_parse_buf(buf, (size_t)n, &(iniopts_t){ .inline_keys = true, .lookup_index = indexed });
+        initable_t *small = ini_get_table(&ini, "small");
+        initable_t *wide = ini_get_table(&ini, "wide");
+        CHECK(ivec_len(small->short_keys) == 2, "small table should keep its inline keys");
+        if (indexed) CHECK(wide->index.slots && !wide->short_keys, "indexed table shouldn't keep inline keys");
+        else         CHECK(ivec_len(wide->short_keys) == 20, "table without index should keep its inline keys");
+        CHECK(ini_as_int(ini_get(wide, "key17")) == 17, "wrong value for key17");
+        CHECK(ini_as_int(ini_get(small, "b")) == 2, "wrong value for b");
+        CHECK(ini_get(wide, "key99") == NULL, "found a key that doesn't exist");
+        ini_free(&ini);
+    }
+}
+
+static void test_only_tables(void) {
+    const char *text =
+        "name = root\n"
+        "[skip]\n"
+        "x = 1\n"
+        "\n"
+        "after = 2\n"
+        "[keep]\n"
+        "y = 3\n"
+        "\r\n"
+        "[skip]\n"
+        "z = 4\r\n"
+        "\r\n"
+        "last = 5\r\n"
+        "[skip]\n"
+        "  [keep]\n"
+        "w = 6\n"
+        "\n"
+        "[skip]\n"
+        "v = 7\n"
+        "# a comment ends the table\n"
+        "comment = 8\n";
+    const char *only[] = { "keep", NULL };
+    ini_t ini = ini_parse_str(text, &(iniopts_t){ .only_tables = only });
+    initable_t *root = ini_get_table(&ini, INI_ROOT);
+    // skipped tables end at the first empty line, what follows is in root
+    CHECK(ini_as_int(ini_get(root, "after")) == 2, "root key after a skipped table was lost");
+    CHECK(ini_as_int(ini_get(root, "last")) == 5, "root key after a skipped table with \\r\\n was lost");
+    CHECK(ini_as_int(ini_get(root, "comment")) == 8, "root key after a comment in a skipped table was lost");
+    CHECK(ini_get(root, "x") == NULL && ini_get(root, "z") == NULL, "keys of a skipped table ended up in root");
+    CHECK(ini_get_table(&ini, "skip") == NULL, "skipped table was parsed");
+    unsigned int keeps = 0, values = 0;
+    initableiter_t it = ini_table_iter(&ini, "keep");
+    for (initable_t *tab = ini_table_next(&it); tab; tab = ini_table_next(&it)) {
+        keeps++;
+        values += ivec_len(tab->values);
+    }
+    CHECK(keeps == 2 && values == 2, "expected 2 keep tables with 1 value each, got %u with %u", keeps, values);
+    ini_free(&ini);
+}
+
+static void test_cache(void) {
+    const char *text = "[db]\nuser = admin\npassword = secret\n";
+    inicache_t cache = {0};
+    inipool_t pool = {0};
+    for (int i = 0; i < 2; ++i) {
+        ini_t ini = ini_parse_str(text, &(iniopts_t){ .cache = &cache });
+        char password[16];
+        ini_to_str(ini_get(ini_get_table(&ini, "db"), "password"), password, sizeof(password), false);
+        CHECK(strcmp(password, "secret") == 0, "wrong cached value: %s", password);
+        ini_free(&ini);
+    }
+    CHECK(cache.hits == 1 && cache.misses == 1, "expected 1 hit and 1 miss, got %llu and %llu", cache.hits, cache.misses);
+    // without the text a hit could only be checked with the fingerprint
+    for (int i = 0; i < 2; ++i) {
+        ini_t ini = ini_parse_str(text, &(iniopts_t){ .cache = &cache, .intern_pool = &pool, .intern_values = true });
+        CHECK(ini_is_valid(&ini), "interned document didn't parse");
+        ini_free(&ini);
+    }
+    CHECK(cache.hits == 1 && ivec_len(cache.entries) == 1, "documents without text shouldn't be cached");
+    ini_cache_free(&cache);
+    ini_pool_free(&pool);
+}
+
+static void test_fingerprint(void) {
+    const char *text = "[a]\nx = 1\n";
+    ini_t a = ini_parse_str(text, NULL);
+    ini_t b = ini_parse_str(text, NULL);
+    ini_t c = ini_parse_str("[a]\nx = 2\n", NULL);
+    static char mem[1024];
+    ini_t d = ini_parse_into(text, strlen(text), mem, sizeof(mem), NULL);
+    CHECK(a.fingerprint == 0, "the fingerprint shouldn't be computed while parsing");
+    CHECK(ini_fingerprint(&a) != 0 && ini_fingerprint(&a) == ini_fingerprint(&b), "same text, different fingerprints");
+    CHECK(ini_fingerprint(&a) != ini_fingerprint(&c), "different text, same fingerprint");
+    CHECK(ini_fingerprint(&a) == ini_fingerprint(&d), "ini_parse_into has a different fingerprint");
+    ini_free(&a);
+    ini_free(&b);
+    ini_free(&c);
+    ini_free(&d);
+
+    // hashed while parsing, a few blocks long with a table that is skipped whole
+    // and a value without a newline at the end
+    const char *long_text =
+        "name = fused\n"
+        "[skipped]\nkey_one = some long enough value\nkey_two = another one\n\n"
+        "[kept]\nkey_three = and a last one without a newline";
+    const char *only_kept[] = { "kept", NULL };
+    iniopts_t fused = { .fingerprint = true, .only_tables = only_kept };
+    ini_t lazy = ini_parse_str(long_text, NULL);
+    ini_t e = ini_parse_str(long_text, &fused);
+    CHECK(e.fingerprint != 0, "the fingerprint wasn't computed while parsing");
+    CHECK(e.fingerprint == ini_fingerprint(&lazy), "hashing while parsing gives a different fingerprint");
+    ini_t f = ini_parse_into(long_text, strlen(long_text), mem, sizeof(mem), &fused);
+    CHECK(f.fingerprint == ini_fingerprint(&lazy), "ini_parse_into hashed a different fingerprint");
+    ini_free(&f);
+    for (size_t len = 0; len < 80; ++len) {
+        ini_t g = ini_parse_buf(long_text, len, &fused);
+        ini_t h = ini_parse_buf(long_text, len, NULL);
+        CHECK(g.fingerprint == ini_fingerprint(&h), "fingerprints differ for %zu bytes", len);
+        ini_free(&g);
+        ini_free(&h);
+    }
+    // without the text it can only be computed while parsing
+    inipool_t pool = {0};
+    iniopts_t interned = { .fingerprint = true, .intern_pool = &pool, .intern_values = true };
+    ini_t i = ini_parse_str(long_text, &interned);
+    CHECK(ini_fingerprint(&i) == ini_fingerprint(&lazy), "the fingerprint was lost with the text");
+    ini_free(&i);
+    ini_pool_free(&pool);
+    ini_free(&e);
+    ini_free(&lazy);
+}
+
+static void test_bounded_numbers(void) {
+    // the value ends where the buffer does, right before "99\n"
+    const char *text = "port=8099\n";
+    static char mem[1024];
+    ini_t fixed = ini_parse_into(text, 7, mem, sizeof(mem), NULL);
+    ini_t copied = ini_parse_buf(text, 7, NULL);
+    inivalue_t *port = ini_get(ini_get_table(&fixed, INI_ROOT), "port");
+    CHECK(ini_as_int(port) == 80, "ini_as_int read past the value: %lld", ini_as_int(port));
+    CHECK(ini_as_uint(port) == 80, "ini_as_uint read past the value: %llu", ini_as_uint(port));
+    CHECK(ini_as_num(port) == 80.0, "ini_as_num read past the value: %f", ini_as_num(port));
+    CHECK(ini_as_int(ini_get(ini_get_table(&copied, INI_ROOT), "port")) == 80, "ini_parse_buf disagrees");
+    ini_free(&fixed);
+    ini_free(&copied);
+}
+
+static void test_max_bytes(void) {
+    char line[64];
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 2] = '\n';
+    line[sizeof(line) - 1] = '\0';
+
+    // regular files are rejected from their size
+    const char *path = "build/max_bytes.ini";
+    FILE *fp = fopen(path, "wb");
+    if (fp) {
+        for (int i = 0; i < 100; ++i) fputs(line, fp);
+        fclose(fp);
+        ini_t ini = ini_parse(path, &(iniopts_t){ .max_bytes = 1024 });
+        CHECK(!ini_is_valid(&ini) && ini.error == INI_LIMIT_BYTES, "big file: got %s", ini_explain(ini.error));
+        ini = ini_parse(path, &(iniopts_t){ .max_bytes = 100 * 63 });
+        CHECK(ini_is_valid(&ini), "file right at the limit was rejected: %s", ini_explain(ini.error));
+        ini_free(&ini);
+        remove(path);
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    // pipes have no size, reading has to stop right after the limit
+    int fds[2];
+    if (pipe(fds) == 0) {
+        size_t written = 0;
+        for (int i = 0; i < 64; ++i) {
+            written += (size_t)write(fds[1], line, strlen(line));
+        }
+        close(fds[1]);
+        FILE *in = fdopen(fds[0], "rb");
+        ini_t ini = ini_parse_fp(in, &(iniopts_t){ .max_bytes = 1024 });
+        CHECK(!ini_is_valid(&ini) && ini.error == INI_LIMIT_BYTES, "big pipe: got %s", ini_explain(ini.error));
+        size_t left = 0;
+        char buf[256];
+        ssize_t n;
+        while ((n = read(fds[0], buf, sizeof(buf))) > 0) left += (size_t)n;
+        CHECK(written - left == 1025, "read %zu bytes from the pipe, expected 1025", written - left);
+        fclose(in);
+    }
+#endif
+}
+
+static void test_layout_duplicate_tables(void) {
+    // three [a] tables with one hit each weigh 3, less than the 5 hits of [b]
+    const char *text = "[a]\nx = 1\n\n[a]\nx = 2\n\n[a]\nx = 3\n\n[b]\nw = 1\n";
+    const char *counts = "[a]\nx = 1\n\n[a]\nx = 1\n\n[a]\nx = 1\n\n[b]\nw = 5\n";
+    ini_t ini = ini_parse_str(text, NULL);
+    ini_t profile = ini_parse_str(counts, NULL);
+    CHECK(ini_optimize_layout(&ini, &profile) == INI_NO_ERR, "ini_optimize_layout failed");
+    const char *order[] = { "root", "b", "a", "a", "a" };
+    for (unsigned int i = 0; i < 5 && i < ivec_len(ini.tables); ++i) {
+        CHECK(strv__cmp(ini.tables[i].name, strv__from_str(order[i])) == 0,
+            "table %u is %.*s, expected %s", i, (int)ini.tables[i].name.len, ini.tables[i].name.buf, order[i]);
+    }
+    CHECK(ini_as_int(ini_get(ini_get_table(&ini, "b"), "w")) == 1, "lost [b] after moving it");
+    ini_free(&profile);
+    ini_free(&ini);
+}
+
+static void test_contiguous_values(void) {
+    const char *text = "name = a\n[one]\nx = 1\ny = 2\n\n[empty]\n\n[two]\nz = 3\n";
+    ini_t ini = ini_parse_str(text, &(iniopts_t){ .contiguous_values = true });
+    CHECK(ini.value_count == 4, "value_count is %u, expected 4", ini.value_count);
+    unsigned int first = 0;
+    const char *prev_end = NULL;
+    for (initable_t *tab = ini.tables; tab != ivec_end(ini.tables); ++tab) {
+        CHECK(tab->first == first, "table %.*s starts at %u, expected %u", (int)tab->name.len, tab->name.buf, tab->first, first);
+        first += ivec_len(tab->values);
+        if (!ivec_len(tab->values)) continue;
+        // each vector follows the previous one, only its header is in between
+        const char *start = (const char *)tab->values - sizeof(unsigned int) * 2;
+        CHECK(!prev_end || start == prev_end, "values of %.*s are not right after the previous table", (int)tab->name.len, tab->name.buf);
+        prev_end = (const char *)ivec_end(tab->values);
+    }
+    CHECK(ini_as_int(ini_get(ini_get_table(&ini, "two"), "z")) == 3, "wrong value for two.z");
+    CHECK(ini_as_int(ini_get(ini_get_table(&ini, "one"), "y")) == 2, "wrong value for one.y");
+
+    // the values are permuted in place, inside the block
+    ini_t profile = ini_parse_str("[two]\nz = 10\n\n[one]\ny = 5\n", NULL);
+    CHECK(ini_optimize_layout(&ini, &profile) == INI_NO_ERR, "couldn't optimize a packed document");
+    initable_t *one = ini_get_table(&ini, "one");
+    CHECK(strv__cmp(one->values[0].key, strv__from_str("y")) == 0, "y wasn't moved first");
+    CHECK(ini_as_int(ini_get(one, "x")) == 1, "lost one.x after optimizing");
+    CHECK(strv__cmp(ini.tables[1].name, strv__from_str("two")) == 0, "[two] wasn't moved first");
+    ini_free(&profile);
+    ini_free(&ini);
+}
+
+static ini_t bundle_get_patched(const char *path, const char *name, void (*patch)(char *data)) {
+    // rewrites the bundle at <path> through <patch> and looks up <name> in it
+    FILE *fp = fopen(path, "rb");
+    char data[8192];
+    size_t size = fp ? fread(data, 1, sizeof(data), fp) : 0;
+    if (fp) fclose(fp);
+    patch(data);
+    fp = fopen(path, "wb");
+    if (fp) {
+        fwrite(data, 1, size, fp);
+        fclose(fp);
+    }
+    inibundle_t bundle = ini_bundle_open(path);
+    ini_t ini = ini_bundle_get(&bundle, name);
+    ini_bundle_close(&bundle);
+    return ini;
+}
+
+static void fill_directory(char *data) {
+    ini__bundle_header_t *header = (ini__bundle_header_t *)data;
+    ini__bundle_dir_t *dir = (ini__bundle_dir_t *)(data + header->dir_off);
+    for (uint32_t i = 0; i < header->dir_cap; ++i) {
+        if (!dir[i].doc_off) dir[i].doc_off = 8;
+    }
+}
+
+static void misalign_documents(char *data) {
+    ini__bundle_header_t *header = (ini__bundle_header_t *)data;
+    ini__bundle_dir_t *dir = (ini__bundle_dir_t *)(data + header->dir_off);
+    for (uint32_t i = 0; i < header->dir_cap; ++i) {
+        if (dir[i].doc_off) dir[i].doc_off += 4;
+    }
+}
+
+static void test_bundle(void) {
+    const char *path = "build/bundle.bundle";
+    ini_t docs[2] = {
+        ini_parse_str("name = first\n[server]\nport = 80\n", NULL),
+        ini_parse_str("name = second\n[server]\nport = 81\nhost = b\n", NULL),
+    };
+    const char *names[2] = { "tenant-1", "tenant-2" };
+    CHECK(ini_bundle_write(path, names, docs, 2) == INI_NO_ERR, "couldn't write the bundle");
+
+    inibundle_t bundle = ini_bundle_open(path);
+    CHECK(ini_bundle_is_valid(&bundle), "couldn't open the bundle");
+    for (int i = 0; i < 2; ++i) {
+        ini_t doc = ini_bundle_get(&bundle, names[i]);
+        initable_t *server = ini_get_table(&doc, "server");
+        CHECK(ini_as_int(ini_get(server, "port")) == 80 + i, "wrong port for %s", names[i]);
+        CHECK(ini_semantic_fingerprint(&doc) == ini_semantic_fingerprint(docs + i), "%s changed in the bundle", names[i]);
+        ini_free(&doc);
+    }
+    ini_t missing = ini_bundle_get(&bundle, "tenant-3");
+    CHECK(!ini_is_valid(&missing), "found a document that isn't in the bundle");
+    ini_bundle_close(&bundle);
+
+    // a directory without empty slots used to loop forever
+    missing = bundle_get_patched(path, "tenant-3", fill_directory);
+    CHECK(!ini_is_valid(&missing), "found a document in a corrupt directory");
+    ini_free(&missing);
+    CHECK(ini_bundle_write(path, names, docs, 2) == INI_NO_ERR, "couldn't write the bundle again");
+    ini_t misaligned = bundle_get_patched(path, "tenant-1", misalign_documents);
+    CHECK(!ini_is_valid(&misaligned), "read a misaligned document");
+    ini_free(&misaligned);
+
+    remove(path);
+    ini_free(docs);
+    ini_free(docs + 1);
+}
+
+typedef struct {
+    unsigned int calls;
+    bool added, removed;
+} sub_events_t;
+
+static void count_sub(inistrv_t table, inistrv_t key, const inivalue_t *old_value, const inivalue_t *new_value, void *userdata) {
+    (void)table; (void)key;
+    sub_events_t *events = userdata;
+    events->calls++;
+    events->added |= !old_value && new_value;
+    events->removed |= old_value && !new_value;
+}
+
+static void test_subscriptions(void) {
+    for (int indexed = 0; indexed < 2; ++indexed) {
+        iniopts_t opts = { .lookup_index = indexed };
+        ini_t v1 = ini_parse_str("name = a\n[server]\nport = 80\n\n[root]\nk = 1\n", &opts);
+        ini_t v2 = ini_parse_str("name = a\n[server]\nport = 81\n\n[root]\nk = 2\n", &opts);
+        sub_events_t root_name = {0}, port = {0}, server = {0}, section = {0}, root_k = {0};
+        inisubs_t subs = {0};
+        ini_subscribe(&subs, INI_ROOT, "name", count_sub, &root_name);
+        ini_subscribe(&subs, "server", "port", count_sub, &port);
+        ini_subscribe(&subs, "server", NULL, count_sub, &server);
+        ini_subscribe(&subs, "root", "k", count_sub, &section);
+        ini_subscribe(&subs, INI_ROOT, "k", count_sub, &root_k);
+
+        ini_notify(&subs, NULL, &v1);
+        CHECK(root_name.added && port.added && section.added, "first load didn't add every key (indexed %d)", indexed);
+        CHECK(server.calls == 1, "table subscriber called %u times on load", server.calls);
+
+        root_name = port = server = section = CDECL(sub_events_t){0};
+        ini_notify(&subs, &v1, &v2);
+        CHECK(root_name.calls == 0, "unchanged root key was reported");
+        CHECK(port.calls == 1 && server.calls == 1, "changed port: %u key, %u table calls", port.calls, server.calls);
+        CHECK(section.calls == 1, "changed key of a [root] section wasn't reported (indexed %d)", indexed);
+
+        root_name = port = section = CDECL(sub_events_t){0};
+        ini_notify(&subs, &v2, NULL);
+        CHECK(root_name.removed, "root key of a removed document wasn't reported (indexed %d)", indexed);
+        CHECK(port.removed && section.removed, "keys of a removed document weren't reported (indexed %d)", indexed);
+        CHECK(root_k.calls == 0, "[root] section key was reported as a root table key");
+
+        ini_subs_free(&subs);
+        ini_free(&v1);
+        ini_free(&v2);
+    }
+}
+
+static void test_get_all(void) {
+    const char *text = "[t]\na = 1\nb = 0\na = 2\nc = 0\na = 3\n";
+    for (int indexed = 0; indexed < 2; ++indexed) {
+        ini_t ini = ini_parse_str(text, &(iniopts_t){ .lookup_index = indexed });
+        initable_t *t = ini_get_table(&ini, "t");
+        iniiter_t it = ini_get_all(t, "a");
+        long long expected = 1;
+        for (inivalue_t *v = ini_iter_next(&it); v; v = ini_iter_next(&it)) {
+            CHECK(ini_as_int(v) == expected, "duplicate %lld came out as %lld (indexed %d)", expected, ini_as_int(v), indexed);
+            expected++;
+        }
+        CHECK(expected == 4, "ini_get_all found %lld duplicates instead of 3 (indexed %d)", expected - 1, indexed);
+        CHECK(ini_iter_next(&it) == NULL, "the iterator restarted after its end");
+        it = ini_get_all(t, "missing");
+        CHECK(ini_iter_next(&it) == NULL, "ini_get_all found a key that doesn't exist");
+        it = ini_get_all(NULL, "a");
+        CHECK(ini_iter_next(&it) == NULL, "ini_get_all on a NULL table found something");
+        ini_free(&ini);
+    }
+    // with override_duplicate_keys only the last one is left
+    ini_t ini = ini_parse_str(text, &(iniopts_t){ .override_duplicate_keys = true });
+    iniiter_t it = ini_get_all(ini_get_table(&ini, "t"), "a");
+    inivalue_t *v = ini_iter_next(&it);
+    CHECK(ini_as_int(v) == 3 && ini_iter_next(&it) == NULL, "overridden keys still have duplicates");
+    ini_free(&ini);
+}
+
+typedef struct {
+    unsigned int values;
+    unsigned int hot, port, unused;
+} access_counts_t;
+
+static void count_access(const initable_t *table, const inivalue_t *value, unsigned int count, void *userdata) {
+    access_counts_t *c = userdata;
+    c->values++;
+    if (strv__cmp(value->key, strv__from_str("hot")) == 0) c->hot += count;
+    else if (strv__cmp(table->name, strv__from_str("server")) == 0) c->port += count;
+    else c->unused += count;
+}
+
+static void test_access_stats(void) {
+    ini_t ini = ini_parse_str("hot = 1\nhot = 2\ncold = 3\n[server]\nport = 80\n", NULL);
+    initable_t *root = ini_get_table(&ini, INI_ROOT);
+    for (int i = 0; i < 3; ++i) ini_get(root, "hot");
+    iniiter_t it = ini_get_all(root, "hot");
+    while (ini_iter_next(&it));
+    CHECK(ini_query(&ini, "serv*", "port", NULL, NULL) == 1, "ini_query didn't find the port");
+    // binding slots is not an access
+    inislots_t slots = {0};
+    ini_slots_add(&slots, INI_ROOT, "cold");
+    ini_slots_bind(&slots, &ini);
+    ini_slots_free(&slots);
+
+    access_counts_t c = {0};
+    ini_access_report(&ini, count_access, &c);
+    CHECK(c.values == 4, "the report went through %u values instead of 4", c.values);
+    CHECK(c.hot == 5, "hot was counted %u times instead of 5", c.hot);
+    CHECK(c.port == 1, "ini_query wasn't counted as an access: %u", c.port);
+    CHECK(c.unused == 0, "keys that were never read have %u accesses", c.unused);
+    ini_free(&ini);
+}
+
+static void test_clone(void) {
+    for (int packed = 0; packed < 2; ++packed) {
+        iniopts_t opts = { .lookup_index = true, .contiguous_values = packed };
+        ini_t original = ini_parse_str("name = a\n[server]\nport = 80\nhost = example\n", &opts);
+        ini_t clone = ini_clone(&original);
+        ini_t second = ini_clone(&clone);
+        CHECK(ini_is_valid(&clone) && ini_is_valid(&second), "cloning failed (packed %d)", packed);
+        CHECK(clone.tables != original.tables, "the clone shares its list of tables");
+
+        // the clones keep the text and the values alive on their own
+        ini_free(&original);
+        initable_t *server = ini_get_table(&clone, "server");
+        CHECK(ini_as_int(ini_get(server, "port")) == 80, "the clone lost its values (packed %d)", packed);
+        CHECK(strv__cmp(ini_get(server, "host")->value, strv__from_str("example")) == 0, "the clone lost its text");
+        ini_free(&clone);
+        CHECK(ini_as_int(ini_get(ini_get_table(&second, "server"), "port")) == 80, "the clone of a clone lost its values");
+        CHECK(ini_get(ini_get_table(&second, INI_ROOT), "name") != NULL, "the clone of a clone lost its root");
+        ini_free(&second);
+    }
+    // documents from ini_parse_into don't own anything to share
+    static char mem[1024];
+    const char *text = "a = 1\n";
+    ini_t fixed = ini_parse_into(text, strlen(text), mem, sizeof(mem), NULL);
+    ini_t clone = ini_clone(&fixed);
+    CHECK(!ini_is_valid(&clone), "a document from ini_parse_into was cloned");
+    ini_free(&fixed);
+}
+
+static void test_delta(void) {
+    ini_t base = ini_parse_str("name = base\n[server]\nport = 80\nhost = example\n", NULL);
+    inidelta_t delta = ini_delta(&base);
+    CHECK(ini_as_int(ini_delta_get(&delta, "server", "port")) == 80, "an empty delta hides the base");
+
+    CHECK(ini_delta_set(&delta, "server", "port", "8080") == INI_NO_ERR, "couldn't set the port");
+    CHECK(ini_delta_remove(&delta, "server", "host") == INI_NO_ERR, "couldn't remove the host");
+    CHECK(ini_delta_set(&delta, INI_ROOT, "extra", "true") == INI_NO_ERR, "couldn't add a key");
+    CHECK(ini_as_int(ini_delta_get(&delta, "server", "port")) == 8080, "the override wasn't used");
+    CHECK(ini_delta_get(&delta, "server", "host") == NULL, "the removed key is still there");
+    CHECK(ini_as_bool(ini_delta_get(&delta, INI_ROOT, "extra")), "the added key is missing");
+    CHECK(ini_delta_get(&delta, INI_ROOT, "name") != NULL, "untouched keys should come from the base");
+    CHECK(ini_delta_get(&delta, "port", "server") == NULL, "table and key were mixed up");
+    CHECK(ini_as_int(ini_get(ini_get_table(&base, "server"), "port")) == 80, "the delta changed the base");
+
+    // a removed key can be set again
+    ini_delta_set(&delta, "server", "host", "other");
+    CHECK(ini_delta_get(&delta, "server", "host") != NULL, "setting a removed key didn't bring it back");
+
+    // only 3/4 of the slots can be used, the keys already in it can still change
+    char keys[INI_DELTA_SLOTS][16];
+    unsigned int added = delta.count;
+    inierr_t err = INI_NO_ERR;
+    for (int i = 0; err == INI_NO_ERR && i < INI_DELTA_SLOTS; ++i) {
+        snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+        err = ini_delta_set(&delta, INI_ROOT, keys[i], "1");
+        if (err == INI_NO_ERR) added++;
+    }
+    CHECK(err == INI_BUFFER_TOO_SMALL, "a full delta accepted a new key");
+    CHECK(added == INI_DELTA_SLOTS * 3 / 4, "the delta is full after %u keys", added);
+    CHECK(ini_delta_set(&delta, "server", "port", "9090") == INI_NO_ERR, "a full delta can't change its keys");
+    CHECK(ini_delta_remove(&delta, INI_ROOT, "key0") == INI_NO_ERR, "a full delta can't remove its keys");
+    CHECK(ini_as_int(ini_delta_get(&delta, "server", "port")) == 9090, "the override wasn't updated");
+    CHECK(ini_delta_get(&delta, INI_ROOT, "key0") == NULL, "the removed key is still there");
+    CHECK(ini_delta_get(&delta, INI_ROOT, "key1") != NULL, "a key of a full delta is missing");
+
+    inidelta_t no_base = ini_delta(NULL);
+    CHECK(ini_delta_get(&no_base, INI_ROOT, "name") == NULL, "a delta without a base found something");
+    ini_free(&base);
+}
+
+typedef struct {
+    unsigned int calls;
+    long long sum;
+} query_sum_t;
+
+static void sum_query(initable_t *table, inivalue_t *value, void *userdata) {
+    (void)table;
+    query_sum_t *q = userdata;
+    q->calls++;
+    q->sum += ini_as_int(value);
+}
+
+static void test_query(void) {
+    char buf[2048];
+    int n = sprintf(buf, "limit = 1000\n[db]\nhost = example\nport = 5432\nport = 5433\n");
+    for (int i = 0; i < 20; ++i) n += sprintf(buf + n, "limit.%c = %d\n", 'a' + i, i);
+    n += sprintf(buf + n, "max_connections = 100\nidle_connections = 10\n\n[db_replica]\nport = 5434\nlimit.a = 50\n");
+    for (int mode = 0; mode < 3; ++mode) {
+        iniopts_t opts = { .lookup_index = mode > 0, .sorted_index = mode == 2 };
+        ini_t ini = ini_parse_buf(buf, (size_t)n, &opts);
+        if (mode == 2) CHECK(ini_get_table(&ini, "db")->index.sorted != NULL, "db wasn't given a sorted index");
+
+        // exact key, every duplicate is a match
+        query_sum_t q = {0};
+        CHECK(ini_query(&ini, "db", "port", sum_query, &q) == 2, "exact key: %u matches (mode %d)", q.calls, mode);
+        CHECK(q.sum == 5432 + 5433, "exact key found the wrong values");
+        // fixed prefix, the sorted index is used when there is one
+        q = CDECL(query_sum_t){0};
+        CHECK(ini_query(&ini, "db", "limit.*", sum_query, &q) == 20, "prefix: %u matches (mode %d)", q.calls, mode);
+        CHECK(q.sum == 190, "prefix found the wrong values: %lld", q.sum);
+        CHECK(ini_query(&ini, "db", "limit.?", NULL, NULL) == 20, "prefix with '?' didn't match every key (mode %d)", mode);
+        CHECK(ini_query(&ini, "db", "limits*", NULL, NULL) == 0, "prefix matched keys that don't start with it");
+        // no fixed prefix, every key is checked
+        CHECK(ini_query(&ini, "db", "*_connections", NULL, NULL) == 2, "suffix didn't match (mode %d)", mode);
+        CHECK(ini_query(&ini, "db", "*conn*", NULL, NULL) == 2, "substring didn't match (mode %d)", mode);
+        CHECK(ini_query(&ini, "db", "*", NULL, NULL) == 25, "'*' didn't match every key (mode %d)", mode);
+        // table patterns and the root table
+        CHECK(ini_query(&ini, "db*", "port", NULL, NULL) == 3, "table glob didn't match both tables (mode %d)", mode);
+        CHECK(ini_query(&ini, "db?replica", "limit.a", NULL, NULL) == 1, "'?' in a table name didn't match");
+        CHECK(ini_query(&ini, INI_ROOT, "limit*", NULL, NULL) == 1, "the root table wasn't queried alone");
+        CHECK(ini_query(&ini, "nothing*", "*", NULL, NULL) == 0, "a table that doesn't exist matched");
+        ini_free(&ini);
+    }
+}
+
+static void test_slots(void) {
+    ini_t v1 = ini_parse_str("debug = true\n[server]\nport = 80\nhost = example\n", NULL);
+    ini_t v2 = ini_parse_str("debug = true\n[server]\nport =   81  \nhost = example\n", NULL);
+    ini_t v3 = ini_parse_str("debug = true\n[server]\nport = 81\nnew = 1\n", NULL);
+    inislots_t slots = {0};
+    int debug = ini_slots_add(&slots, INI_ROOT, "debug");
+    int port = ini_slots_add(&slots, "server", "port");
+    int host = ini_slots_add(&slots, "server", "host");
+    int added = ini_slots_add(&slots, "server", "new");
+    CHECK(debug == 0 && port == 1 && host == 2 && added == 3, "slot ids aren't in order");
+    CHECK(ini_slots_add(&slots, "server", NULL) < 0, "a slot without a key was added");
+
+    // keys that are missing from the start haven't changed
+    CHECK(ini_slots_bind(&slots, &v1) == 3, "first bind should fill 3 slots");
+    CHECK(slots.slots[port].as_int == 80 && slots.slots[debug].as_bool, "slots weren't converted");
+    CHECK(!slots.slots[added].changed && !slots.slots[added].value, "a missing key was marked as changed");
+
+    // whitespace around the value is not a change
+    CHECK(ini_slots_bind(&slots, &v2) == 1, "only the port changed");
+    CHECK(slots.slots[port].changed && slots.slots[port].generation == 2, "port: changed %d, generation %u",
+          slots.slots[port].changed, slots.slots[port].generation);
+    CHECK(!slots.slots[host].changed && slots.slots[host].generation == 1, "the host didn't change");
+    CHECK(slots.slots[host].value && slots.slots[host].value != slots.slots[port].value, "the host slot points to the wrong value");
+
+    // a key going away or appearing is a change
+    CHECK(ini_slots_bind(&slots, &v3) == 2, "host and new changed");
+    CHECK(slots.slots[host].changed && !slots.slots[host].value, "the removed host is still there");
+    CHECK(slots.slots[added].changed && slots.slots[added].generation == 1, "the new key wasn't reported");
+    CHECK(!slots.slots[port].changed && slots.slots[port].generation == 2, "an unchanged port was reported");
+
+    // binding the same document again changes nothing, no document clears every slot
+    CHECK(ini_slots_bind(&slots, &v3) == 0, "binding twice reported changes");
+    CHECK(ini_slots_bind(&slots, NULL) == 3, "unbinding didn't clear every slot");
+    CHECK(!slots.slots[debug].value && !slots.slots[debug].as_bool, "unbound slot still has its value");
+    ini_slots_free(&slots);
+    ini_free(&v1);
+    ini_free(&v2);
+    ini_free(&v3);
+}
+
+static bool cancel_after(void *userdata) {
+    int *calls = userdata;
+    return --*calls < 0;
+}
+
+static void test_limits(void) {
+    const char *text = "a = 1\nb = 2\n[one]\nc = 3\nd = 4\ne = 5\n\n[two]\nf = 6\n\n[one]\ng = 7\n";
+    static char mem[4096];
+    const struct {
+        iniopts_t opts;
+        inierr_t error;
+    } cases[] = {
+        { { .max_tables = 3 }, INI_NO_ERR },
+        { { .max_tables = 2 }, INI_LIMIT_TABLES },
+        // merged tables are only counted once
+        { { .max_tables = 2, .merge_duplicate_tables = true }, INI_NO_ERR },
+        { { .max_keys = 7 }, INI_NO_ERR },
+        { { .max_keys = 6 }, INI_LIMIT_KEYS },
+        { { .max_table_keys = 3 }, INI_NO_ERR },
+        { { .max_table_keys = 2 }, INI_LIMIT_TABLE_KEYS },
+        { { .max_table_keys = 3, .merge_duplicate_tables = true }, INI_LIMIT_TABLE_KEYS },
+        { { .max_line_length = 5 }, INI_NO_ERR },
+        { { .max_line_length = 4 }, INI_LIMIT_LINE },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+        ini_t ini = ini_parse_str(text, &cases[i].opts);
+        CHECK(ini.error == cases[i].error, "case %zu: %s instead of %s", i, ini_explain(ini.error), ini_explain(cases[i].error));
+        CHECK(ini_is_valid(&ini) == (cases[i].error == INI_NO_ERR), "case %zu: a document that hit a limit is valid", i);
+        ini_free(&ini);
+        if (cases[i].opts.merge_duplicate_tables) continue;
+        ini = ini_parse_into(text, strlen(text), mem, sizeof(mem), &cases[i].opts);
+        CHECK(ini.error == cases[i].error, "case %zu: ini_parse_into gave %s", i, ini_explain(ini.error));
+        ini_free(&ini);
+    }
+
+    // overridden keys don't count
+    ini_t ini = ini_parse_str("k = 1\nk = 2\nk = 3\n", &(iniopts_t){ .override_duplicate_keys = true, .max_keys = 1 });
+    CHECK(ini.error == INI_NO_ERR, "overridden keys were counted: %s", ini_explain(ini.error));
+    ini_free(&ini);
+
+    // cancel is called every INI_CANCEL_INTERVAL bytes, the first time right away
+    size_t len = (INI_CANCEL_INTERVAL * 3 / 10 + 10) * 10;
+    char *big = malloc(len);
+    for (size_t i = 0; i < len; i += 10) memcpy(big + i, "key = 12\n\n", 10);
+    int calls = 100;
+    ini = ini_parse_buf(big, len, &(iniopts_t){ .cancel = cancel_after, .userdata = &calls });
+    CHECK(ini.error == INI_NO_ERR && 100 - calls == 4, "cancel was called %d times instead of 4", 100 - calls);
+    ini_free(&ini);
+    calls = 2;
+    ini = ini_parse_buf(big, len, &(iniopts_t){ .cancel = cancel_after, .userdata = &calls });
+    CHECK(ini.error == INI_CANCELLED && !ini_is_valid(&ini), "parsing wasn't cancelled: %s", ini_explain(ini.error));
+    ini_free(&ini);
+    free(big);
+}
+
+int main(void) {
+    test_inline_keys();
+    test_only_tables();
+    test_cache();
+    test_fingerprint();
+    test_bounded_numbers();
+    test_max_bytes();
+    test_layout_duplicate_tables();
+    test_subscriptions();
+    test_contiguous_values();
+    test_bundle();
+    test_get_all();
+    test_access_stats();
+    test_clone();
+    test_delta();
+    test_query();
+    test_slots();
+    test_limits();
+    if (failures) {
+        printf("parse: %d failures\n", failures);
+        return 1;
+    }
+    printf("parse: ok\n");
+    return 0;
+}